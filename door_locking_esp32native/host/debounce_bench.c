@@ -0,0 +1,449 @@
+/*
+ * Replays Hall edge traces through the firmware debouncer (main/hall_debounce.c), driven the
+ * way hall_sensor.c drives it, and scores the reported transitions against the door
+ * movements annotated in the trace.
+ *
+ * Trace format, one record per line, '#' starts a comment:
+ *   debounce <ms>        Channel stable window (HALL_DEBOUNCE_MS if omitted)
+ *   init <0|1>           Level at replay start, 1 = open
+ *   edge <t_us> <0|1>    Pin level after an edge
+ *   door <t_us> <0|1>    Door movement that must be reported once, at its first contact edge
+ *   end <t_us>           Replay length (last edge plus one second if omitted)
+ */
+#include "hall_debounce.h"
+#include "sim_gpio.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+#define DEFAULT_DEBOUNCE_MS     100     // HALL_DEBOUNCE_MS in config.h.example
+#define DEFAULT_TICK_US         10000   // CONFIG_FREERTOS_HZ=100
+#define DEFAULT_RING_SIZE       32      // HALL_EDGE_RING_SIZE in hall_sensor.c
+#define DEFAULT_ISR_LATENCY_US  5       // Edge to snapshot in the ISR
+#define DEFAULT_TASK_LATENCY_US 200     // ISR notification to hall_task running
+
+/**
+ * @brief Model parameters, from the command line
+ */
+typedef struct {
+    uint16_t window_ms;         // Like the debounce_ms setting: overrides the trace, 0 = use the trace
+    int64_t tick_us;
+    size_t ring_size;
+    int64_t isr_latency_us;
+    int64_t task_latency_us;
+    double max_latency_ms;      // Door movement to report, 0 = no limit
+    double max_settle_ms;       // Last bounce to report, 0 = no limit
+} bench_config_t;
+
+/**
+ * @brief Door movement annotated in a trace
+ */
+typedef struct {
+    int64_t timestamp_us;
+    bool open;
+    bool reported;
+} door_move_t;
+
+typedef struct {
+    uint16_t debounce_ms;
+    bool initial_open;
+    int64_t end_us;
+    sim_edge_t *edges;
+    size_t edge_count;
+    door_move_t *doors;
+    size_t door_count;
+} trace_t;
+
+/**
+ * @brief Transition returned by hall_sensor_wait_events()
+ */
+typedef struct {
+    int64_t reported_us;
+    int64_t settled_us;         // Last edge of the burst
+    bool open;
+    uint32_t bounces;
+} report_t;
+
+typedef struct {
+    uint32_t interrupts;
+    uint32_t dropped;           // Snapshots lost to a full ring
+    uint32_t glitches;
+    uint32_t restarts;          // Confirmation reads that disagreed with the snapshots
+    report_t *reports;
+    size_t report_count;
+    uint32_t false_transitions;
+    uint32_t missed_transitions;
+    double latency_min_ms;
+    double latency_max_ms;
+    double latency_sum_ms;
+    double settled_max_ms;      // Worst last edge to report, the cost of the window itself
+    uint32_t max_bounces;
+} bench_result_t;
+
+// ----------------- Trace loading -----------------
+static void *grow(void *array, size_t count, size_t *capacity, size_t item_size)
+{
+    if (count < *capacity) {
+        return array;
+    }
+    *capacity = *capacity ? *capacity * 2 : 64;
+    void *grown = realloc(array, *capacity * item_size);
+    if (grown == NULL) {
+        fprintf(stderr, "Out of memory\n");
+        exit(2);
+    }
+    return grown;
+}
+
+/**
+ * @brief Parse a trace file
+ * @return true on success, false with a message on stderr otherwise
+ */
+static bool trace_load(const char *path, trace_t *trace)
+{
+    *trace = (trace_t){ .debounce_ms = DEFAULT_DEBOUNCE_MS, .initial_open = true, .end_us = -1 };
+    FILE *file = fopen(path, "r");
+    if (file == NULL) {
+        fprintf(stderr, "%s: cannot open\n", path);
+        return false;
+    }
+    
+    size_t edge_capacity = 0;
+    size_t door_capacity = 0;
+    char line[160];
+    unsigned line_no = 0;
+    bool ok = true;
+    
+    while (ok && fgets(line, sizeof(line), file) != NULL) {
+        line_no++;
+        char *comment = strchr(line, '#');
+        if (comment != NULL) {
+            *comment = '\0';
+        }
+        
+        char keyword[16];
+        int64_t t_us;
+        int level;
+        unsigned value;
+        if (sscanf(line, "%15s", keyword) != 1) {
+            continue;
+        }
+        
+        if (strcmp(keyword, "edge") == 0 && sscanf(line, "%*s %" SCNd64 " %d", &t_us, &level) == 2) {
+            if (trace->edge_count > 0 && t_us < trace->edges[trace->edge_count - 1].timestamp_us) {
+                fprintf(stderr, "%s:%u: edges out of order\n", path, line_no);
+                ok = false;
+                break;
+            }
+            trace->edges = grow(trace->edges, trace->edge_count, &edge_capacity, sizeof(sim_edge_t));
+            trace->edges[trace->edge_count++] = (sim_edge_t){ .timestamp_us = t_us, .open = level != 0 };
+        } else if (strcmp(keyword, "door") == 0 && sscanf(line, "%*s %" SCNd64 " %d", &t_us, &level) == 2) {
+            trace->doors = grow(trace->doors, trace->door_count, &door_capacity, sizeof(door_move_t));
+            trace->doors[trace->door_count++] = (door_move_t){ .timestamp_us = t_us, .open = level != 0 };
+        } else if (strcmp(keyword, "init") == 0 && sscanf(line, "%*s %d", &level) == 1) {
+            trace->initial_open = level != 0;
+        } else if (strcmp(keyword, "debounce") == 0 && sscanf(line, "%*s %u", &value) == 1 && value > 0 &&
+                   value <= UINT16_MAX) {
+            trace->debounce_ms = (uint16_t)value;
+        } else if (strcmp(keyword, "end") == 0 && sscanf(line, "%*s %" SCNd64, &t_us) == 1) {
+            trace->end_us = t_us;
+        } else {
+            fprintf(stderr, "%s:%u: malformed record\n", path, line_no);
+            ok = false;
+        }
+    }
+    fclose(file);
+    
+    if (ok && trace->end_us < 0) {
+        int64_t last_us = trace->edge_count > 0 ? trace->edges[trace->edge_count - 1].timestamp_us : 0;
+        trace->end_us = last_us + 1000000;
+    }
+    return ok;
+}
+
+static void trace_free(trace_t *trace)
+{
+    free(trace->edges);
+    free(trace->doors);
+}
+
+// ----------------- Replay -----------------
+/**
+ * @brief Run the ISR, ring and hall_sensor_wait_events() loop of hall_sensor.c over a trace
+ * Every snapshot is attributed to the replayed channel's own interrupt.
+ */
+static void replay(const trace_t *trace, const bench_config_t *config, bench_result_t *result)
+{
+    uint16_t window_ms = config->window_ms ? config->window_ms : trace->debounce_ms;
+    sim_edge_t *ring = malloc(config->ring_size * sizeof(sim_edge_t));
+    size_t ring_count = 0;
+    size_t report_capacity = 0;
+    hall_debounce_t debounce;
+    
+    if (ring == NULL) {
+        fprintf(stderr, "Out of memory\n");
+        exit(2);
+    }
+    
+    sim_gpio_load(trace->edges, trace->edge_count, trace->initial_open);
+    hall_debounce_reset(&debounce, window_ms, sim_gpio_get_level(), 0);
+    
+    // hall_sensor_init() arms the level trigger for the opposite of the level it read
+    int64_t trigger_us = sim_gpio_find_level(!sim_gpio_get_level(), 0);
+    int64_t isr_us = trigger_us == INT64_MAX ? INT64_MAX : trigger_us + config->isr_latency_us;
+    // hall_task waits for events right after initialization
+    int64_t wake_us = 0;
+    
+    while (1) {
+        if (isr_us <= wake_us && isr_us < trace->end_us) {
+            sim_timer_set_time(isr_us);
+            bool open = sim_gpio_get_level();
+            result->interrupts++;
+            if (ring_count >= config->ring_size) {
+                result->dropped++;
+            } else {
+                ring[ring_count++] = (sim_edge_t){ .timestamp_us = isr_us, .open = open };
+            }
+            
+            // The notification wakes the consumer unless it already runs earlier
+            if (isr_us + config->task_latency_us < wake_us) {
+                wake_us = isr_us + config->task_latency_us;
+            }
+            
+            // Re-armed for the opposite level; fires again at once if the pin already flipped back
+            trigger_us = sim_gpio_find_level(!open, isr_us);
+            isr_us = trigger_us == INT64_MAX ? INT64_MAX : trigger_us + config->isr_latency_us;
+            continue;
+        }
+        if (wake_us >= trace->end_us) {
+            break;
+        }
+        
+        sim_timer_set_time(wake_us);
+        int64_t now = sim_timer_get_time();
+        for (size_t i = 0; i < ring_count; i++) {
+            hall_debounce_edge(&debounce, ring[i].open, true, ring[i].timestamp_us);
+        }
+        ring_count = 0;
+        
+        // hall_sensor_settle(): confirm a due burst against the pin
+        hall_debounce_outcome_t outcome;
+        switch (hall_debounce_settle(&debounce, sim_gpio_get_level(), now, &outcome)) {
+            case HALL_DEBOUNCE_RESTARTED:
+                result->restarts++;
+                break;
+            case HALL_DEBOUNCE_GLITCH:
+                result->glitches++;
+                break;
+            case HALL_DEBOUNCE_TRANSITION:
+                result->reports = grow(result->reports, result->report_count, &report_capacity, sizeof(report_t));
+                result->reports[result->report_count++] = (report_t){
+                    .reported_us = now,
+                    .settled_us = outcome.timestamp_us + outcome.settle_us,
+                    .open = outcome.open,
+                    .bounces = outcome.bounces,
+                };
+                break;
+            case HALL_DEBOUNCE_IDLE:
+                break;
+        }
+        
+        // hall_sensor_next_deadline(): ulTaskNotifyTake() rounds the wait up to whole ticks
+        int64_t deadline_us = hall_debounce_deadline(&debounce);
+        if (deadline_us == INT64_MAX) {
+            wake_us = INT64_MAX;
+        } else if (deadline_us <= now) {
+            wake_us = now;
+        } else {
+            int64_t ticks = (deadline_us - now + 999) / 1000 * 1000 / config->tick_us + 1;
+            wake_us = (now / config->tick_us + ticks) * config->tick_us;
+        }
+    }
+    
+    free(ring);
+}
+
+// ----------------- Scoring -----------------
+/**
+ * @brief Match every report to the door movement in effect when it was reported
+ * A report matches the latest movement before it if that movement is still unreported and
+ * has the same state; anything else is a false transition, unreported movements are missed.
+ */
+static void score(trace_t *trace, bench_result_t *result)
+{
+    result->latency_min_ms = 0;
+    result->latency_max_ms = 0;
+    result->latency_sum_ms = 0;
+    result->settled_max_ms = 0;
+    size_t matched = 0;
+    
+    for (size_t r = 0; r < result->report_count; r++) {
+        const report_t *report = &result->reports[r];
+        if (report->bounces > result->max_bounces) {
+            result->max_bounces = report->bounces;
+        }
+        double settled_ms = (double)(report->reported_us - report->settled_us) / 1000.0;
+        if (settled_ms > result->settled_max_ms) {
+            result->settled_max_ms = settled_ms;
+        }
+        
+        // Before the first movement the door rests in the debouncer's initial open state
+        door_move_t *door = NULL;
+        for (size_t d = 0; d < trace->door_count && trace->doors[d].timestamp_us <= report->reported_us; d++) {
+            door = &trace->doors[d];
+        }
+        if (door == NULL || door->reported || door->open != report->open) {
+            result->false_transitions++;
+            continue;
+        }
+        
+        door->reported = true;
+        double latency_ms = (double)(report->reported_us - door->timestamp_us) / 1000.0;
+        if (matched == 0 || latency_ms < result->latency_min_ms) {
+            result->latency_min_ms = latency_ms;
+        }
+        if (latency_ms > result->latency_max_ms) {
+            result->latency_max_ms = latency_ms;
+        }
+        result->latency_sum_ms += latency_ms;
+        matched++;
+    }
+    
+    result->missed_transitions = (uint32_t)(trace->door_count - matched);
+}
+
+// ----------------- Command line -----------------
+static void usage(const char *argv0)
+{
+    fprintf(stderr,
+            "usage: %s [options] trace...\n"
+            "  --window-ms N        Override the trace's stable window (like the debounce_ms setting)\n"
+            "  --tick-ms N          FreeRTOS tick period (default %d)\n"
+            "  --ring N             Edge ring capacity (default %d)\n"
+            "  --isr-latency-us N   Edge to ISR snapshot (default %d)\n"
+            "  --task-latency-us N  ISR to hall_task running (default %d)\n"
+            "  --max-latency-ms N   Fail if a door movement is reported later than this\n"
+            "  --max-settle-ms N    Fail if a transition is reported later than this after its last bounce\n",
+            argv0, DEFAULT_TICK_US / 1000, DEFAULT_RING_SIZE, DEFAULT_ISR_LATENCY_US, DEFAULT_TASK_LATENCY_US);
+}
+
+static bool parse_number(const char *text, long min, long max, long *out)
+{
+    char *end;
+    long value = strtol(text, &end, 10);
+    if (end == text || *end != '\0' || value < min || value > max) {
+        return false;
+    }
+    *out = value;
+    return true;
+}
+
+/**
+ * @brief Replay and report one trace
+ * @return true if it passed
+ */
+static bool run_trace(const char *path, const bench_config_t *config)
+{
+    trace_t trace;
+    if (!trace_load(path, &trace)) {
+        trace_free(&trace);
+        return false;
+    }
+    
+    bench_result_t result = {0};
+    replay(&trace, config, &result);
+    score(&trace, &result);
+    
+    size_t matched = trace.door_count - result.missed_transitions;
+    const char *name = strrchr(path, '/') ? strrchr(path, '/') + 1 : path;
+    printf("%s: window %u ms, tick %" PRId64 " ms, ring %zu\n", name,
+           config->window_ms ? config->window_ms : trace.debounce_ms, config->tick_us / 1000, config->ring_size);
+    printf("  edges %zu, interrupts %" PRIu32 ", dropped %" PRIu32 ", glitches %" PRIu32 ", restarts %" PRIu32 "\n",
+           trace.edge_count, result.interrupts, result.dropped, result.glitches, result.restarts);
+    printf("  transitions %zu (state publishes) for %zu door movements: false %" PRIu32 ", missed %" PRIu32
+           ", max bounces %" PRIu32 "\n",
+           result.report_count, trace.door_count, result.false_transitions, result.missed_transitions,
+           result.max_bounces);
+    if (matched > 0) {
+        printf("  detection latency: min %.1f ms, avg %.1f ms, max %.1f ms (max %.1f ms after the last bounce)\n",
+               result.latency_min_ms, result.latency_sum_ms / (double)matched, result.latency_max_ms,
+               result.settled_max_ms);
+    }
+    
+    bool passed = true;
+    if (result.false_transitions > 0 || result.missed_transitions > 0) {
+        printf("  FAIL: %" PRIu32 " false and %" PRIu32 " missed transitions\n", result.false_transitions,
+               result.missed_transitions);
+        passed = false;
+    }
+    if (config->max_latency_ms > 0 && result.latency_max_ms > config->max_latency_ms) {
+        printf("  FAIL: latency %.1f ms above the %.1f ms limit\n", result.latency_max_ms, config->max_latency_ms);
+        passed = false;
+    }
+    if (config->max_settle_ms > 0 && result.settled_max_ms > config->max_settle_ms) {
+        printf("  FAIL: %.1f ms from the last bounce, above the %.1f ms limit\n", result.settled_max_ms,
+               config->max_settle_ms);
+        passed = false;
+    }
+    
+    free(result.reports);
+    trace_free(&trace);
+    return passed;
+}
+
+int main(int argc, char **argv)
+{
+    bench_config_t config = {
+        .window_ms = 0,
+        .tick_us = DEFAULT_TICK_US,
+        .ring_size = DEFAULT_RING_SIZE,
+        .isr_latency_us = DEFAULT_ISR_LATENCY_US,
+        .task_latency_us = DEFAULT_TASK_LATENCY_US,
+        .max_latency_ms = 0,
+        .max_settle_ms = 0,
+    };
+    int first_trace = argc;
+    
+    for (int i = 1; i < argc; i++) {
+        long value;
+        if (argv[i][0] != '-') {
+            first_trace = i;
+            break;
+        }
+        if (i + 1 >= argc) {
+            usage(argv[0]);
+            return 2;
+        }
+        
+        const char *option = argv[i++];
+        if (strcmp(option, "--window-ms") == 0 && parse_number(argv[i], 1, UINT16_MAX, &value)) {
+            config.window_ms = (uint16_t)value;
+        } else if (strcmp(option, "--tick-ms") == 0 && parse_number(argv[i], 1, 1000, &value)) {
+            config.tick_us = value * 1000;
+        } else if (strcmp(option, "--ring") == 0 && parse_number(argv[i], 1, 4096, &value)) {
+            config.ring_size = (size_t)value;
+        } else if (strcmp(option, "--isr-latency-us") == 0 && parse_number(argv[i], 1, 1000000, &value)) {
+            config.isr_latency_us = value;
+        } else if (strcmp(option, "--task-latency-us") == 0 && parse_number(argv[i], 0, 1000000, &value)) {
+            config.task_latency_us = value;
+        } else if (strcmp(option, "--max-latency-ms") == 0 && parse_number(argv[i], 1, 100000, &value)) {
+            config.max_latency_ms = (double)value;
+        } else if (strcmp(option, "--max-settle-ms") == 0 && parse_number(argv[i], 1, 100000, &value)) {
+            config.max_settle_ms = (double)value;
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (first_trace >= argc) {
+        usage(argv[0]);
+        return 2;
+    }
+    
+    bool passed = true;
+    for (int i = first_trace; i < argc; i++) {
+        passed &= run_trace(argv[i], &config);
+    }
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,70 @@
+#include "sim_gpio.h"
+
+static const sim_edge_t *timeline = NULL;
+static size_t timeline_count = 0;
+static bool timeline_initial = false;
+static int64_t clock_us = 0;
+
+/**
+ * @brief Index of the first edge after t_us
+ */
+static size_t edges_until(int64_t t_us)
+{
+    size_t lo = 0;
+    size_t hi = timeline_count;
+    
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (timeline[mid].timestamp_us <= t_us) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+static bool level_at(int64_t t_us)
+{
+    size_t n = edges_until(t_us);
+    return n == 0 ? timeline_initial : timeline[n - 1].open;
+}
+
+void sim_gpio_load(const sim_edge_t *edges, size_t count, bool initial_open)
+{
+    timeline = edges;
+    timeline_count = count;
+    timeline_initial = initial_open;
+    clock_us = 0;
+}
+
+bool sim_gpio_get_level(void)
+{
+    return level_at(clock_us);
+}
+
+int64_t sim_gpio_find_level(bool open, int64_t from_us)
+{
+    if (level_at(from_us) == open) {
+        return from_us;
+    }
+    
+    for (size_t i = edges_until(from_us); i < timeline_count; i++) {
+        if (timeline[i].open == open) {
+            return timeline[i].timestamp_us;
+        }
+    }
+    return INT64_MAX;
+}
+
+int64_t sim_timer_get_time(void)
+{
+    return clock_us;
+}
+
+void sim_timer_set_time(int64_t now_us)
+{
+    if (now_us > clock_us) {
+        clock_us = now_us;
+    }
+}
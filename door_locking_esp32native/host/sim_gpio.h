@@ -0,0 +1,56 @@
+#ifndef SIM_GPIO_H
+#define SIM_GPIO_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * Host stand-ins for the Hall pin and esp_timer.
+ * The pin follows a recorded edge list and time only moves when the replay sets
+ * the clock, so a trace produces the same result on every run.
+ */
+
+/**
+ * @brief Pin level change in a trace
+ */
+typedef struct {
+    int64_t timestamp_us;
+    bool open;              // Level after the edge, already mapped through open_level
+} sim_edge_t;
+
+/**
+ * @brief Replace the pin timeline (edges must be sorted by time and stay valid)
+ * @param edges Level changes
+ * @param count Number of edges
+ * @param initial_open Level before the first edge
+ */
+void sim_gpio_load(const sim_edge_t *edges, size_t count, bool initial_open);
+
+/**
+ * @brief Read the pin at the current simulated time, like gpio_get_level()
+ * @return true if the channel reads open
+ */
+bool sim_gpio_get_level(void);
+
+/**
+ * @brief Find when the pin next reads a level, as a level interrupt would see it
+ * @param open Level the interrupt is armed for
+ * @param from_us Earliest time to consider
+ * @return First time >= from_us at which the pin reads open, INT64_MAX if never
+ */
+int64_t sim_gpio_find_level(bool open, int64_t from_us);
+
+/**
+ * @brief Get the simulated time, like esp_timer_get_time()
+ * @return Microseconds since replay start
+ */
+int64_t sim_timer_get_time(void);
+
+/**
+ * @brief Move the simulated clock
+ * @param now_us New time, never earlier than the current one
+ */
+void sim_timer_set_time(int64_t now_us);
+
+#endif // SIM_GPIO_H
@@ -0,0 +1,393 @@
+#include "binlog.h"
+#include "config.h"
+#include "rtos_alloc.h"
+#include "esp_timer.h"
+#include "esp_app_desc.h"
+#include "nvs.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+
+static const char *TAG = "BINLOG";
+
+#define BINLOG_RING_MASK    (BINLOG_RING_RECORDS - 1)
+#define BINLOG_NVS_NS       "binlog"
+#define BINLOG_NVS_KEY      "snapshot"
+#define BINLOG_LINE_MAX     160
+
+_Static_assert((BINLOG_RING_RECORDS & BINLOG_RING_MASK) == 0, "BINLOG_RING_RECORDS must be a power of two");
+
+typedef struct {
+    binlog_module_t module;
+    esp_log_level_t level;
+    const char *format;
+} binlog_message_t;
+
+// Indexed by binlog_msg_id_t; lives in flash
+#define BINLOG_MSG_ENTRY(id, module, level, format) \
+    [BINLOG_MSG_##id] = { BINLOG_MODULE_##module, ESP_LOG_##level, format },
+static const binlog_message_t messages[BINLOG_MSG_COUNT] = {
+    BINLOG_MESSAGES(BINLOG_MSG_ENTRY)
+};
+#undef BINLOG_MSG_ENTRY
+
+static const char *const module_names[BINLOG_MODULE_COUNT] = {
+    [BINLOG_MODULE_HALL_SENSOR]    = "HALL_SENSOR",
+    [BINLOG_MODULE_BUZZER]         = "BUZZER",
+    [BINLOG_MODULE_WIFI_MANAGER]   = "WIFI_MANAGER",
+    [BINLOG_MODULE_DOOR_LOCK]      = "DOOR_LOCK",
+    [BINLOG_MODULE_PUBLISHER]      = "PUBLISHER",
+    [BINLOG_MODULE_ESPNOW_GATEWAY] = "ESPNOW_GATEWAY",
+};
+
+static const char level_letters[] = { 'N', 'E', 'W', 'I', 'D', 'V' };
+
+// Usable before binlog_init(), so early boot messages are kept
+static atomic_uint module_levels[BINLOG_MODULE_COUNT] = {
+    [0 ... BINLOG_MODULE_COUNT - 1] = BINLOG_DEFAULT_LEVEL
+};
+
+// Written from any task and esp_timer callbacks; drained from the console, command or drain task
+static portMUX_TYPE binlog_lock = portMUX_INITIALIZER_UNLOCKED;
+static binlog_record_t ring[BINLOG_RING_RECORDS];
+static uint32_t ring_head = 0;           // Next slot to write
+static uint32_t ring_count = 0;
+static uint32_t written_count = 0;
+static uint32_t overwritten_count = 0;
+
+static TaskHandle_t drain_task_handle = NULL;
+RTOS_TASK_STORAGE(binlog_drain, BINLOG_DRAIN_TASK_STACK_SIZE);
+
+/**
+ * @brief Snapshot header; the table hash rejects snapshots whose formats no longer match,
+ * and the image hash those from another build, whose string arguments point into its rodata
+ */
+typedef struct {
+    uint32_t table_hash;
+    uint8_t elf_sha256[8];      // Prefix of the writing image's ELF SHA-256
+    uint32_t count;
+} binlog_snapshot_header_t;
+
+/**
+ * @brief FNV-1a hash over every message format
+ */
+static uint32_t message_table_hash(void)
+{
+    uint32_t hash = 2166136261u;
+    for (size_t id = 0; id < BINLOG_MSG_COUNT; id++) {
+        for (const char *p = messages[id].format; *p != '\0'; p++) {
+            hash ^= (uint8_t)*p;
+            hash *= 16777619u;
+        }
+        hash ^= (uint32_t)messages[id].module;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// ----------------- Recording -----------------
+void binlog_write(binlog_msg_id_t id, const uint32_t *args, size_t argc)
+{
+    if (id >= BINLOG_MSG_COUNT) {
+        return;
+    }
+    const binlog_message_t *message = &messages[id];
+    if (message->level > atomic_load_explicit(&module_levels[message->module], memory_order_relaxed)) {
+        return;
+    }
+    
+    binlog_record_t record = {
+        .timestamp_ms = (uint32_t)(esp_timer_get_time() / 1000),
+        .id = (uint16_t)id,
+        .argc = (uint8_t)(argc < BINLOG_MAX_ARGS ? argc : BINLOG_MAX_ARGS),
+    };
+    memcpy(record.args, args, record.argc * sizeof(uint32_t));
+    
+    portENTER_CRITICAL(&binlog_lock);
+    // A full ring overwrites its oldest record
+    ring[ring_head] = record;
+    ring_head = (ring_head + 1) & BINLOG_RING_MASK;
+    if (ring_count < BINLOG_RING_RECORDS) {
+        ring_count++;
+    } else {
+        overwritten_count++;
+    }
+    written_count++;
+    bool first = ring_count == 1;
+    portEXIT_CRITICAL(&binlog_lock);
+    
+    // Only the first record of a burst wakes the drain task
+    if (first && drain_task_handle != NULL) {
+        xTaskNotifyGive(drain_task_handle);
+    }
+}
+
+bool binlog_read(binlog_record_t *record)
+{
+    bool found = false;
+    
+    portENTER_CRITICAL(&binlog_lock);
+    if (ring_count > 0) {
+        *record = ring[(ring_head - ring_count) & BINLOG_RING_MASK];
+        ring_count--;
+        found = true;
+    }
+    portEXIT_CRITICAL(&binlog_lock);
+    
+    return found;
+}
+
+// ----------------- Formatting -----------------
+/**
+ * @brief Append one conversion ("%08x", "%s", ...) for a single argument
+ * @return Characters the conversion needed (may exceed the space left)
+ */
+static int format_conversion(char *buf, size_t len, const char *spec, char conversion, uint32_t value)
+{
+    switch (conversion) {
+        case 'd':
+        case 'c':
+            return snprintf(buf, len, spec, (int)value);
+        case 'u':
+        case 'x':
+        case 'X':
+            return snprintf(buf, len, spec, (unsigned int)value);
+        case 's':
+            return snprintf(buf, len, spec, value ? (const char *)(uintptr_t)value : "(null)");
+        default:
+            return 0;
+    }
+}
+
+size_t binlog_format(const binlog_record_t *record, char *buf, size_t len)
+{
+    if (len == 0) {
+        return 0;
+    }
+    if (record->id >= BINLOG_MSG_COUNT) {
+        int written = snprintf(buf, len, "? (%lu) BINLOG: unknown message %u",
+                               (unsigned long)record->timestamp_ms, record->id);
+        return written < 0 ? 0 : ((size_t)written < len ? (size_t)written : len - 1);
+    }
+    
+    const binlog_message_t *message = &messages[record->id];
+    int written = snprintf(buf, len, "%c (%lu) %s: ", level_letters[message->level],
+                           (unsigned long)record->timestamp_ms, module_names[message->module]);
+    size_t pos = written < 0 ? 0 : (size_t)written;
+    size_t arg = 0;
+    
+    for (const char *p = message->format; *p != '\0' && pos < len - 1; ) {
+        if (*p != '%') {
+            buf[pos++] = *p++;
+            continue;
+        }
+        
+        // Rebuild the conversion without length modifiers: every argument is 32 bits
+        char spec[8];
+        size_t n = 0;
+        spec[n++] = *p++;
+        while (*p >= '0' && *p <= '9' && n < sizeof(spec) - 2) {
+            spec[n++] = *p++;
+        }
+        while (*p == 'l') {
+            p++;
+        }
+        char conversion = *p;
+        if (conversion == '\0') {
+            break;
+        }
+        p++;
+        if (conversion == '%') {
+            buf[pos++] = '%';
+            continue;
+        }
+        spec[n++] = conversion;
+        spec[n] = '\0';
+        
+        uint32_t value = arg < record->argc ? record->args[arg++] : 0;
+        written = format_conversion(buf + pos, len - pos, spec, conversion, value);
+        if (written > 0) {
+            pos += (size_t)written;
+        }
+    }
+    
+    if (pos > len - 1) {
+        pos = len - 1;
+    }
+    buf[pos] = '\0';
+    return pos;
+}
+
+size_t binlog_drain_to_uart(void)
+{
+    binlog_record_t record;
+    char line[BINLOG_LINE_MAX];
+    size_t count = 0;
+    
+    while (binlog_read(&record)) {
+        binlog_format(&record, line, sizeof(line));
+        printf("%s\n", line);
+        count++;
+    }
+    return count;
+}
+
+// ----------------- Drain task -----------------
+static void binlog_drain_task(void *pvParameters)
+{
+    while (1) {
+        // Sleeps without a timeout while the ring is empty, so an idle device is never woken
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        
+        // Let the rest of the burst arrive, then print it in one pass
+        vTaskDelay(pdMS_TO_TICKS(BINLOG_UART_DRAIN_MS));
+        ulTaskNotifyTake(pdTRUE, 0);
+        binlog_drain_to_uart();
+    }
+}
+
+esp_err_t binlog_init(void)
+{
+    for (size_t module = 0; module < BINLOG_MODULE_COUNT; module++) {
+        esp_log_level_set(module_names[module], binlog_get_level(module));
+    }
+    
+    if (BINLOG_UART_DRAIN_MS > 0) {
+        esp_err_t ret = rtos_task_create(binlog_drain_task, "binlog", BINLOG_DRAIN_TASK_STACK_SIZE, NULL,
+                                         BINLOG_DRAIN_TASK_PRIORITY, RTOS_CORE_NETWORK,
+                                         RTOS_TASK(binlog_drain), &drain_task_handle);
+        if (ret != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to create drain task");
+            return ret;
+        }
+        // Records written before the task existed
+        xTaskNotifyGive(drain_task_handle);
+    }
+    
+    ESP_LOGI(TAG, "Binary log initialized (%u records, UART drain %s)", (unsigned)BINLOG_RING_RECORDS,
+             BINLOG_UART_DRAIN_MS > 0 ? "on" : "on demand");
+    return ESP_OK;
+}
+
+// ----------------- Levels -----------------
+esp_err_t binlog_set_level(binlog_module_t module, esp_log_level_t level)
+{
+    if (module >= BINLOG_MODULE_COUNT || level > ESP_LOG_VERBOSE) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    atomic_store_explicit(&module_levels[module], level, memory_order_relaxed);
+    esp_log_level_set(module_names[module], level);
+    return ESP_OK;
+}
+
+esp_log_level_t binlog_get_level(binlog_module_t module)
+{
+    if (module >= BINLOG_MODULE_COUNT) {
+        return ESP_LOG_NONE;
+    }
+    return (esp_log_level_t)atomic_load_explicit(&module_levels[module], memory_order_relaxed);
+}
+
+esp_err_t binlog_module_from_name(const char *name, binlog_module_t *module)
+{
+    for (size_t i = 0; i < BINLOG_MODULE_COUNT; i++) {
+        if (strcmp(module_names[i], name) == 0) {
+            *module = (binlog_module_t)i;
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_NOT_FOUND;
+}
+
+const char *binlog_module_name(binlog_module_t module)
+{
+    return module < BINLOG_MODULE_COUNT ? module_names[module] : "?";
+}
+
+void binlog_get_stats(binlog_stats_t *stats)
+{
+    portENTER_CRITICAL(&binlog_lock);
+    stats->written = written_count;
+    stats->overwritten = overwritten_count;
+    stats->pending = ring_count;
+    portEXIT_CRITICAL(&binlog_lock);
+}
+
+// ----------------- Flash snapshot -----------------
+esp_err_t binlog_save_to_flash(void)
+{
+    static binlog_record_t snapshot[BINLOG_FLASH_RECORDS];   // Too large for the caller's stack
+    static uint8_t blob[sizeof(binlog_snapshot_header_t) + sizeof(snapshot)];
+    
+    // Newest records, oldest first, left in the ring
+    portENTER_CRITICAL(&binlog_lock);
+    uint32_t count = ring_count < BINLOG_FLASH_RECORDS ? ring_count : BINLOG_FLASH_RECORDS;
+    for (uint32_t i = 0; i < count; i++) {
+        snapshot[i] = ring[(ring_head - count + i) & BINLOG_RING_MASK];
+    }
+    portEXIT_CRITICAL(&binlog_lock);
+    
+    binlog_snapshot_header_t header = {
+        .table_hash = message_table_hash(),
+        .count = count,
+    };
+    memcpy(header.elf_sha256, esp_app_get_description()->app_elf_sha256, sizeof(header.elf_sha256));
+    memcpy(blob, &header, sizeof(header));
+    memcpy(blob + sizeof(header), snapshot, count * sizeof(binlog_record_t));
+    
+    nvs_handle_t nvs;
+    esp_err_t ret = nvs_open(BINLOG_NVS_NS, NVS_READWRITE, &nvs);
+    if (ret == ESP_OK) {
+        ret = nvs_set_blob(nvs, BINLOG_NVS_KEY, blob, sizeof(header) + count * sizeof(binlog_record_t));
+        if (ret == ESP_OK) {
+            ret = nvs_commit(nvs);
+        }
+        nvs_close(nvs);
+    }
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to save log snapshot: %s", esp_err_to_name(ret));
+        return ret;
+    }
+    
+    ESP_LOGI(TAG, "Saved %lu records to flash", (unsigned long)count);
+    return ESP_OK;
+}
+
+esp_err_t binlog_load_from_flash(binlog_record_t *records, size_t max, size_t *count)
+{
+    static uint8_t blob[sizeof(binlog_snapshot_header_t) + BINLOG_FLASH_RECORDS * sizeof(binlog_record_t)];
+    *count = 0;
+    
+    nvs_handle_t nvs;
+    esp_err_t ret = nvs_open(BINLOG_NVS_NS, NVS_READONLY, &nvs);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    size_t len = sizeof(blob);
+    ret = nvs_get_blob(nvs, BINLOG_NVS_KEY, blob, &len);
+    nvs_close(nvs);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    
+    binlog_snapshot_header_t header;
+    if (len < sizeof(header)) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    memcpy(&header, blob, sizeof(header));
+    if (header.table_hash != message_table_hash() ||
+        memcmp(header.elf_sha256, esp_app_get_description()->app_elf_sha256, sizeof(header.elf_sha256)) != 0) {
+        return ESP_ERR_INVALID_VERSION;
+    }
+    
+    size_t stored = (len - sizeof(header)) / sizeof(binlog_record_t);
+    if (stored > header.count) {
+        stored = header.count;
+    }
+    *count = stored < max ? stored : max;
+    memcpy(records, blob + sizeof(header), *count * sizeof(binlog_record_t));
+    return ESP_OK;
+}
@@ -0,0 +1,186 @@
+#ifndef BINLOG_H
+#define BINLOG_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "esp_log.h"
+
+#define BINLOG_MAX_ARGS     4   // 32-bit arguments stored per record
+
+/**
+ * @brief Modules with a runtime-selectable verbosity; names match their ESP_LOG tags
+ */
+typedef enum {
+    BINLOG_MODULE_HALL_SENSOR = 0,
+    BINLOG_MODULE_BUZZER,
+    BINLOG_MODULE_WIFI_MANAGER,
+    BINLOG_MODULE_DOOR_LOCK,
+    BINLOG_MODULE_PUBLISHER,
+    BINLOG_MODULE_ESPNOW_GATEWAY,
+    BINLOG_MODULE_COUNT
+} binlog_module_t;
+
+/**
+ * @brief Hot-path messages: X(id, module, level, format)
+ * Formats support %d, %u, %x, %X, %c and %s with an optional zero flag and width; 'l' is ignored.
+ * %s arguments must have static storage (string literals, tables in flash), since they are
+ * only dereferenced when the record is drained.
+ */
+#define BINLOG_MESSAGES(X) \
+    X(EDGE_OVERFLOW,      HALL_SENSOR,    WARN,  "Hall edge ring overflowed (%lu edges dropped)") \
+    X(DOOR_EVENT,         DOOR_LOCK,      INFO,  "Channel %u: Door %s (%u bounces, settled in %luus)") \
+    X(MQTT_CONNECTED,     DOOR_LOCK,      INFO,  "Connected to MQTT broker%s") \
+    X(MQTT_SUBSCRIBE,     DOOR_LOCK,      INFO,  "Subscribed to topic: %s") \
+    X(MQTT_SUBSCRIBED,    DOOR_LOCK,      INFO,  "MQTT_EVENT_SUBSCRIBED, msg_id=%d") \
+    X(MQTT_DISCONNECTED,  DOOR_LOCK,      WARN,  "Disconnected from MQTT broker") \
+    X(MQTT_DATA,          DOOR_LOCK,      INFO,  "MQTT message (topic %d bytes, data %d bytes)") \
+    X(BEEP_START,         BUZZER,         INFO,  "Started beep sequence: %d times, %dms each") \
+    X(BEEP_PATTERN,       BUZZER,         INFO,  "Playing pattern %d (%s)") \
+    X(BEEP_DONE,          BUZZER,         INFO,  "Beep sequence completed") \
+    X(BEEP_STOP,          BUZZER,         INFO,  "Buzzer stopped") \
+    X(PUBLISHED,          PUBLISHER,      INFO,  "Published: %s to %s (seq %lu)") \
+    X(STORED_OFFLINE,     PUBLISHER,      INFO,  "MQTT not connected, stored %u events in outbox") \
+    X(REPLAYING,          PUBLISHER,      INFO,  "Replaying %u outbox records (%lu pending)") \
+    X(COALESCED,          PUBLISHER,      INFO,  "Coalesced %lu transitions") \
+    X(WIFI_DISCONNECTED,  WIFI_MANAGER,   WARN,  "Disconnected from AP (reason %u)") \
+    X(WIFI_GOT_IP,        WIFI_MANAGER,   INFO,  "Got IP:%d.%d.%d.%d") \
+    X(WIFI_GOT_IP_CACHED, WIFI_MANAGER,   INFO,  "Got IP:%d.%d.%d.%d (cached lease)") \
+    X(WIFI_CACHE_UPDATED, WIFI_MANAGER,   INFO,  "Fast-connect cache updated (channel %d)") \
+    X(ESPNOW_FORWARDED,   ESPNOW_GATEWAY, INFO,  "Node %s: Door %s (seq %lu, %d dBm)") \
+    X(ESPNOW_DUPLICATE,   ESPNOW_GATEWAY, DEBUG, "Node %s: repeated seq %lu ignored") \
+    X(ESPNOW_UNKNOWN,     ESPNOW_GATEWAY, WARN,  "Frame from unknown node ..:%02x:%02x:%02x (%d bytes)")
+
+#define BINLOG_MSG_ENUM(id, module, level, format) BINLOG_MSG_##id,
+typedef enum {
+    BINLOG_MESSAGES(BINLOG_MSG_ENUM)
+    BINLOG_MSG_COUNT
+} binlog_msg_id_t;
+#undef BINLOG_MSG_ENUM
+
+/**
+ * @brief One log record: message id plus raw arguments, formatted only when drained
+ */
+typedef struct {
+    uint32_t timestamp_ms;      // Since boot
+    uint16_t id;                // binlog_msg_id_t
+    uint8_t argc;
+    uint8_t reserved;
+    uint32_t args[BINLOG_MAX_ARGS];
+} binlog_record_t;
+
+/**
+ * @brief Ring buffer counters
+ */
+typedef struct {
+    uint32_t written;           // Records stored since boot
+    uint32_t overwritten;       // Oldest records lost before they were drained
+    uint32_t pending;           // Records waiting to be drained
+} binlog_stats_t;
+
+/**
+ * @brief Record a message if its module's level allows it
+ * Arguments are 32-bit integers; wrap string pointers in BINLOG_STR().
+ * Costs a table lookup and a copy under a spinlock; never formats, blocks or touches the UART.
+ */
+#define BINLOG(msg, ...) do { \
+    const uint32_t binlog_args_[] = { 0, ##__VA_ARGS__ }; \
+    binlog_write(BINLOG_MSG_##msg, binlog_args_ + 1, sizeof(binlog_args_) / sizeof(uint32_t) - 1); \
+} while (0)
+
+#define BINLOG_STR(s) ((uint32_t)(uintptr_t)(s))
+
+/**
+ * @brief Apply the module levels to the ESP_LOG tags and start the UART drain task
+ * Recording works before this is called; the drain task only exists with BINLOG_UART_DRAIN_MS > 0.
+ * @return ESP_OK on success, error code on failure
+ */
+esp_err_t binlog_init(void);
+
+/**
+ * @brief Store a record (use the BINLOG() macro)
+ * Task context only, including esp_timer callbacks; not for ISRs.
+ * @param id Message id
+ * @param args Arguments
+ * @param argc Argument count (extra arguments beyond BINLOG_MAX_ARGS are dropped)
+ */
+void binlog_write(binlog_msg_id_t id, const uint32_t *args, size_t argc);
+
+/**
+ * @brief Remove the oldest record from the ring
+ * @param record Receives the record
+ * @return true if a record was returned, false if the ring is empty
+ */
+bool binlog_read(binlog_record_t *record);
+
+/**
+ * @brief Format a record as an ESP_LOG style line ("I (1234) BUZZER: ...", no newline)
+ * @param record Record to format
+ * @param buf Output buffer
+ * @param len Buffer size
+ * @return Length written (truncated output is still NUL-terminated)
+ */
+size_t binlog_format(const binlog_record_t *record, char *buf, size_t len);
+
+/**
+ * @brief Format and print every pending record to stdout
+ * @return Number of records printed
+ */
+size_t binlog_drain_to_uart(void);
+
+/**
+ * @brief Set a module's level for both binary records and its ESP_LOG tag
+ * @param module Module
+ * @param level ESP_LOG_NONE to ESP_LOG_VERBOSE
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG for an unknown module or level
+ */
+esp_err_t binlog_set_level(binlog_module_t module, esp_log_level_t level);
+
+/**
+ * @brief Get a module's level
+ * @param module Module
+ * @return Level, ESP_LOG_NONE for an unknown module
+ */
+esp_log_level_t binlog_get_level(binlog_module_t module);
+
+/**
+ * @brief Look up a module by its tag name ("BUZZER", ...)
+ * @param name Tag name
+ * @param module Receives the module
+ * @return ESP_OK on success, ESP_ERR_NOT_FOUND for an unknown name
+ */
+esp_err_t binlog_module_from_name(const char *name, binlog_module_t *module);
+
+/**
+ * @brief Get a module's tag name
+ * @param module Module
+ * @return Name, or "?" for an unknown module
+ */
+const char *binlog_module_name(binlog_module_t module);
+
+/**
+ * @brief Get the ring buffer counters
+ * @param stats Receives the counters
+ */
+void binlog_get_stats(binlog_stats_t *stats);
+
+/**
+ * @brief Save the newest pending records to NVS as raw records, without draining them
+ * Keeps up to BINLOG_FLASH_RECORDS and replaces the previous snapshot.
+ * @return ESP_OK on success, error code on failure
+ */
+esp_err_t binlog_save_to_flash(void);
+
+/**
+ * @brief Load the snapshot written by binlog_save_to_flash(), possibly from an earlier boot
+ * @param records Output array
+ * @param max Capacity of records
+ * @param count Receives the number of records loaded
+ * @return ESP_OK on success, ESP_ERR_NVS_NOT_FOUND if there is no snapshot,
+ *         ESP_ERR_INVALID_VERSION if it was written by another firmware image, whose string
+ *         arguments no longer resolve
+ */
+esp_err_t binlog_load_from_flash(binlog_record_t *records, size_t max, size_t *count);
+
+#endif // BINLOG_H
@@ -0,0 +1,180 @@
+#include "boot_profile.h"
+#include "config.h"
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_system.h"
+#include "esp_sleep.h"
+#include "driver/gpio.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+static const char *TAG = "BOOT_PROFILE";
+
+#define BOOT_PROFILE_MAGIC  0xB007F11E
+
+typedef struct {
+    uint16_t number;                        // Cycle counter since the last power-on
+    uint8_t reset_reason;                   // esp_reset_reason_t
+    uint8_t wake_cause;                     // esp_sleep_wakeup_cause_t
+    uint8_t published;
+    uint32_t phase_us[BOOT_PHASE_COUNT];    // Since reset, 0 = not reached
+} boot_cycle_t;
+
+typedef struct {
+    uint32_t magic;
+    uint16_t next_number;
+    uint8_t head;                           // Current cycle
+    uint8_t count;
+    boot_cycle_t cycles[BOOT_PROFILE_CYCLES];
+} boot_profile_store_t;
+
+// Survives deep sleep and software resets (OTA, panic); validated after power-on
+static RTC_NOINIT_ATTR boot_profile_store_t store;
+
+// Previous cycles included in the last formatted summary
+static uint32_t formatted_mask = 0;
+static bool gpio_level = false;
+
+_Static_assert(BOOT_PROFILE_CYCLES <= 32, "formatted_mask has one bit per cycle");
+
+void boot_profile_begin(void)
+{
+    if (!BOOT_PROFILE_ENABLE) {
+        return;
+    }
+    
+    uint32_t now = (uint32_t)esp_timer_get_time();
+    esp_reset_reason_t reason = esp_reset_reason();
+    
+    // RTC_NOINIT memory is random after power-on
+    if (reason == ESP_RST_POWERON || store.magic != BOOT_PROFILE_MAGIC ||
+        store.head >= BOOT_PROFILE_CYCLES || store.count > BOOT_PROFILE_CYCLES) {
+        memset(&store, 0, sizeof(store));
+        store.magic = BOOT_PROFILE_MAGIC;
+        store.head = BOOT_PROFILE_CYCLES - 1;
+    }
+    
+    // The oldest cycle is overwritten once the ring is full, published or not
+    store.head = (store.head + 1) % BOOT_PROFILE_CYCLES;
+    if (store.count < BOOT_PROFILE_CYCLES) {
+        store.count++;
+    }
+    
+    boot_cycle_t *cycle = &store.cycles[store.head];
+    memset(cycle, 0, sizeof(*cycle));
+    cycle->number = store.next_number++;
+    cycle->reset_reason = (uint8_t)reason;
+    cycle->wake_cause = (uint8_t)esp_sleep_get_wakeup_cause();
+    cycle->phase_us[BOOT_PHASE_APP_START] = now;
+    
+#if BOOT_PROFILE_GPIO >= 0
+    {
+        gpio_config_t io_conf = {
+            .intr_type = GPIO_INTR_DISABLE,
+            .mode = GPIO_MODE_OUTPUT,
+            .pin_bit_mask = (1ULL << BOOT_PROFILE_GPIO),
+            .pull_down_en = GPIO_PULLDOWN_DISABLE,
+            .pull_up_en = GPIO_PULLUP_DISABLE,
+        };
+        gpio_config(&io_conf);
+        gpio_level = true;
+        gpio_set_level(BOOT_PROFILE_GPIO, gpio_level);
+    }
+#endif
+    
+    ESP_LOGI(TAG, "Cycle %u, reset reason %d, wake cause %d, app start at %luus", cycle->number,
+             (int)reason, cycle->wake_cause, (unsigned long)now);
+}
+
+void boot_profile_mark(boot_phase_t phase)
+{
+    if (!BOOT_PROFILE_ENABLE || phase >= BOOT_PHASE_COUNT || store.magic != BOOT_PROFILE_MAGIC) {
+        return;
+    }
+    
+    boot_cycle_t *cycle = &store.cycles[store.head];
+    if (cycle->phase_us[phase] != 0) {
+        return;
+    }
+    
+    // One register write; the analyzer measures the phase between two edges
+    if (BOOT_PROFILE_GPIO >= 0) {
+        gpio_level = !gpio_level;
+        gpio_set_level(BOOT_PROFILE_GPIO, gpio_level);
+    }
+    
+    int64_t now = esp_timer_get_time();
+    cycle->phase_us[phase] = now > UINT32_MAX ? UINT32_MAX : (uint32_t)now;
+}
+
+/**
+ * @brief Append one cycle as [n,reset,wake,t0,...]
+ * @return Characters written, 0 if it did not fit
+ */
+static size_t format_cycle(const boot_cycle_t *cycle, char *buf, size_t len)
+{
+    int written = snprintf(buf, len, "[%u,%u,%u", cycle->number, cycle->reset_reason, cycle->wake_cause);
+    size_t pos = written < 0 ? len : (size_t)written;
+    
+    for (size_t phase = 0; phase < BOOT_PHASE_COUNT && pos < len; phase++) {
+        written = snprintf(buf + pos, len - pos, ",%lu", (unsigned long)cycle->phase_us[phase]);
+        pos += written < 0 ? len : (size_t)written;
+    }
+    if (pos + 1 >= len) {
+        return 0;
+    }
+    buf[pos++] = ']';
+    buf[pos] = '\0';
+    return pos;
+}
+
+size_t boot_profile_format_json(char *buf, size_t len)
+{
+    formatted_mask = 0;
+    if (!BOOT_PROFILE_ENABLE || store.magic != BOOT_PROFILE_MAGIC || len < sizeof("{\"cycles\":[]}")) {
+        return 0;
+    }
+    
+    // Reserve the closing "]}" while appending
+    size_t limit = len - 2;
+    size_t pos = (size_t)snprintf(buf, len, "{\"cycles\":[");
+    
+    // Oldest first, ending with the current cycle
+    for (size_t age = store.count; age-- > 0; ) {
+        size_t index = (store.head + BOOT_PROFILE_CYCLES - age) % BOOT_PROFILE_CYCLES;
+        const boot_cycle_t *cycle = &store.cycles[index];
+        if (age > 0 && cycle->published) {
+            continue;
+        }
+        
+        size_t separator = pos > sizeof("{\"cycles\":[") - 1 ? 1 : 0;
+        size_t written = format_cycle(cycle, buf + pos + separator, limit - pos - separator);
+        if (written == 0) {
+            break;   // Full; the remaining cycles go out next time
+        }
+        if (separator) {
+            buf[pos] = ',';
+        }
+        pos += separator + written;
+        if (age > 0) {
+            formatted_mask |= 1u << index;
+        }
+    }
+    
+    buf[pos++] = ']';
+    buf[pos++] = '}';
+    buf[pos] = '\0';
+    return pos;
+}
+
+void boot_profile_mark_published(void)
+{
+    for (size_t index = 0; index < BOOT_PROFILE_CYCLES; index++) {
+        if (formatted_mask & (1u << index)) {
+            store.cycles[index].published = 1;
+        }
+    }
+    formatted_mask = 0;
+}
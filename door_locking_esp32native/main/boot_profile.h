@@ -0,0 +1,65 @@
+#ifndef BOOT_PROFILE_H
+#define BOOT_PROFILE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+/*
+ * Boot and wake-cycle profiling (BOOT_PROFILE_ENABLE). Every cycle from reset or
+ * deep-sleep wakeup to the next one is kept in RTC memory with the time each phase
+ * was reached, so cycles that end in deep sleep or a reboot can be published later.
+ * Shared with the sleep build; each firmware marks the phases it goes through.
+ */
+
+/**
+ * @brief Phases in the order they are usually reached
+ */
+typedef enum {
+    BOOT_PHASE_APP_START = 0,   // app_main entered (ROM and bootloader time included)
+    BOOT_PHASE_NVS,             // nvs_flash_init() done
+    BOOT_PHASE_SETTINGS,        // Runtime settings loaded
+    BOOT_PHASE_OUTBOX,          // Offline outbox and OTA state loaded
+    BOOT_PHASE_SENSOR,          // Hall sensor ready (sleep build: level sampled)
+    BOOT_PHASE_DRIVERS,         // Publisher, buzzer and LED ready
+    BOOT_PHASE_SERVICES,        // Telemetry, commands and rules ready
+    BOOT_PHASE_TASKS,           // Application tasks running
+    BOOT_PHASE_WIFI_START,      // WiFi started, association in progress
+    BOOT_PHASE_WIFI_CONNECTED,  // IP obtained
+    BOOT_PHASE_MQTT_CONNECTED,  // Broker connected
+    BOOT_PHASE_PUBLISHED,       // Sleep build: state acknowledged by the broker
+    BOOT_PHASE_SLEEP,           // Sleep build: entering deep sleep
+    BOOT_PHASE_COUNT
+} boot_phase_t;
+
+/**
+ * @brief Start a new cycle record; call first thing in app_main
+ * Also drives BOOT_PROFILE_GPIO high when one is configured. Does nothing without BOOT_PROFILE_ENABLE.
+ */
+void boot_profile_begin(void);
+
+/**
+ * @brief Record the time a phase was reached in this cycle
+ * Only the first mark of a phase counts, so later reconnects do not overwrite the boot values.
+ * Toggles BOOT_PROFILE_GPIO, so an external power analyzer sees an edge at every phase boundary.
+ * @param phase Phase reached
+ */
+void boot_profile_mark(boot_phase_t phase);
+
+/**
+ * @brief Format the cycles not published yet, the current one last, as compact JSON
+ * {"cycles":[[n,reset,wake,t0,...,t12],...]}: cycle number, esp_reset_reason(),
+ * esp_sleep_get_wakeup_cause(), then microseconds since reset per boot_phase_t, 0 if not reached.
+ * @param buf Output buffer
+ * @param len Buffer size
+ * @return Length written, 0 if profiling is disabled or the buffer is too small
+ */
+size_t boot_profile_format_json(char *buf, size_t len);
+
+/**
+ * @brief Mark the cycles included in the last boot_profile_format_json() as published
+ * The current cycle stays unpublished, since it may still reach later phases.
+ */
+void boot_profile_mark_published(void);
+
+#endif // BOOT_PROFILE_H
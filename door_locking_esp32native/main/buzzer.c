@@ -1,31 +1,195 @@
 #include "buzzer.h"
 #include "config.h"
+#include "binlog.h"
 #include "esp_log.h"
 #include "driver/gpio.h"
 #include "freertos/FreeRTOS.h"
-#include "freertos/task.h"
-#include "freertos/semphr.h"
 #include "esp_timer.h"
+#include "esp_pm.h"
 
 static const char *TAG = "BUZZER";
 
-// Buzzer state variables
+#define PATTERN_STEPS(...) \
+    .steps = (const uint16_t[]){ __VA_ARGS__ }, \
+    .step_count = sizeof((const uint16_t[]){ __VA_ARGS__ }) / sizeof(uint16_t)
+
+// A playing sequence is only replaced by one of the same or a higher priority
+#define PRIORITY_SIGNAL     0   // Door chime, BEEP command
+#define PRIORITY_REMINDER   1   // Door-ajar reminder
+#define PRIORITY_ALARM      2   // Forced entry, sounds until disarmed
+
+/**
+ * @brief Pattern: alternating on/off durations in ms, starting with "on"
+ */
+typedef struct {
+    const char *name;
+    const uint16_t *steps;
+    uint8_t step_count;
+    uint8_t repeat;          // Number of plays, 0 = until buzzer_stop_beep()
+    uint8_t priority;
+} buzzer_pattern_t;
+
+// Indexed by buzzer_pattern_id_t; lives in flash
+static const buzzer_pattern_t patterns[BUZZER_PATTERN_COUNT] = {
+    [BUZZER_PATTERN_BEEP]       = { "beep",       PATTERN_STEPS(300, 300),                 5, PRIORITY_SIGNAL },
+    [BUZZER_PATTERN_SHORT_LONG] = { "short-long", PATTERN_STEPS(100, 100, 600, 400),       3, PRIORITY_SIGNAL },
+    [BUZZER_PATTERN_DOOR_AJAR]  = { "door-ajar",  PATTERN_STEPS(80, 120, 80, 1500),        2, PRIORITY_REMINDER },
+    [BUZZER_PATTERN_ALARM]      = { "alarm",      PATTERN_STEPS(250, 100, 250, 100, 800, 400), 0, PRIORITY_ALARM },
+};
+
+// Player state
 static bool beep_active = false;
-static int beep_times = 0;
-static int beep_duration = 0;
-static uint64_t beep_start_time = 0;
-static bool buzzer_state = false;  // Current buzzer output state
-static int beep_count = 0;  // Current beep count
+static const uint16_t *play_steps = NULL;
+static uint8_t play_step_count = 0;
+static uint8_t play_step = 0;       // Index of the phase currently playing
+static uint8_t play_repeat = 0;     // Plays requested, 0 = forever
+static uint8_t play_count = 0;      // Plays completed
+static uint8_t play_priority = 0;
+static bool buzzer_state = false;   // Current buzzer output state
+
+// Steps for buzzer_start_beep(); the only pattern not taken from the table
+static uint16_t custom_steps[2];
+
+// One-shot timer fired at every on/off phase boundary; nothing runs between edges
+static esp_timer_handle_t buzzer_timer = NULL;
+static portMUX_TYPE buzzer_lock = portMUX_INITIALIZER_UNLOCKED;
+// Expiries already dispatched to the esp_timer task when their pattern was cancelled
+static uint8_t stale_expiries = 0;
+
+// Held while a pattern plays so light sleep cannot stretch the phases
+static esp_pm_lock_handle_t buzzer_pm_lock = NULL;
+static bool pm_lock_held = false;
+
+// Called with buzzer_lock held
+static void buzzer_pm_hold(bool hold)
+{
+    if (buzzer_pm_lock == NULL || hold == pm_lock_held) {
+        return;
+    }
+    
+    if (hold) {
+        esp_pm_lock_acquire(buzzer_pm_lock);
+    } else {
+        esp_pm_lock_release(buzzer_pm_lock);
+    }
+    pm_lock_held = hold;
+}
+
+/**
+ * @brief Stop the phase timer and mark the player idle (called with buzzer_lock held)
+ * With ESP_TIMER_TASK dispatch an expired timer's callback may already be waiting for the
+ * lock, and esp_timer_stop() cannot withdraw it. While a pattern plays the callback either
+ * re-arms the timer or ends the pattern under the lock, so a stopped timer during playback
+ * means such a callback is on its way; it is counted and ignored when it arrives.
+ */
+static void buzzer_cancel(void)
+{
+    if (esp_timer_stop(buzzer_timer) != ESP_OK && beep_active) {
+        stale_expiries++;
+    }
+    beep_active = false;
+}
+
+/**
+ * @brief Advance the pattern by one phase (esp_timer task context)
+ */
+static void buzzer_timer_callback(void *arg)
+{
+    bool completed = false;
+    
+    portENTER_CRITICAL(&buzzer_lock);
+    if (stale_expiries > 0) {
+        // Belongs to a cancelled pattern; it must not advance the one playing now
+        stale_expiries--;
+    } else if (beep_active) {
+        play_step++;
+        if (play_step >= play_step_count) {
+            play_step = 0;
+            play_count++;
+        }
+        
+        // The pause after the last beep of the last play is not waited for
+        bool last_play = (play_repeat != 0 && play_count >= play_repeat - 1);
+        bool trailing_pause = (play_step == play_step_count - 1 && (play_step % 2) == 1);
+        if ((play_repeat != 0 && play_count >= play_repeat) || (last_play && trailing_pause)) {
+            gpio_set_level(BUZZER_PIN, 0);
+            buzzer_state = false;
+            beep_active = false;
+            buzzer_pm_hold(false);
+            completed = true;
+        } else {
+            // Even steps sound, odd steps are pauses
+            buzzer_state = (play_step % 2) == 0;
+            gpio_set_level(BUZZER_PIN, buzzer_state);
+            esp_timer_start_once(buzzer_timer, (uint64_t)play_steps[play_step] * 1000);
+        }
+    }
+    portEXIT_CRITICAL(&buzzer_lock);
+    
+    if (completed) {
+        BINLOG(BEEP_DONE);
+    }
+}
+
+/**
+ * @brief Check whether a sequence of this priority may replace the current one (buzzer_lock held)
+ */
+static bool buzzer_may_preempt(uint8_t priority)
+{
+    return !beep_active || priority >= play_priority;
+}
 
-static SemaphoreHandle_t buzzer_mutex = NULL;
+/**
+ * @brief Start playing a step sequence from its first (on) phase
+ * @return ESP_OK, or ESP_ERR_INVALID_STATE if a higher-priority sequence is playing
+ */
+static esp_err_t buzzer_play_steps(const uint16_t *steps, uint8_t step_count, uint8_t repeat, uint8_t priority)
+{
+    portENTER_CRITICAL(&buzzer_lock);
+    if (!buzzer_may_preempt(priority)) {
+        portEXIT_CRITICAL(&buzzer_lock);
+        return ESP_ERR_INVALID_STATE;
+    }
+    
+    // Stop any current pattern
+    buzzer_cancel();
+    
+    play_steps = steps;
+    play_step_count = step_count;
+    play_step = 0;
+    play_repeat = repeat;
+    play_count = 0;
+    play_priority = priority;
+    beep_active = true;
+    buzzer_pm_hold(true);
+    
+    // Start first beep; the timer takes it from here
+    gpio_set_level(BUZZER_PIN, 1);
+    buzzer_state = true;
+    esp_timer_start_once(buzzer_timer, (uint64_t)steps[0] * 1000);
+    
+    portEXIT_CRITICAL(&buzzer_lock);
+    return ESP_OK;
+}
 
 esp_err_t buzzer_init(void)
 {
-    // Create mutex for thread safety
-    buzzer_mutex = xSemaphoreCreateMutex();
-    if (buzzer_mutex == NULL) {
-        ESP_LOGE(TAG, "Failed to create buzzer mutex");
-        return ESP_FAIL;
+    const esp_timer_create_args_t timer_args = {
+        .callback = buzzer_timer_callback,
+        .arg = NULL,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "buzzer",
+    };
+    
+    esp_err_t ret = esp_timer_create(&timer_args, &buzzer_timer);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to create buzzer timer: %s", esp_err_to_name(ret));
+        return ret;
+    }
+    
+    // Not supported without CONFIG_PM_ENABLE; the buzzer then simply runs unlocked
+    if (esp_pm_lock_create(ESP_PM_NO_LIGHT_SLEEP, 0, "buzzer", &buzzer_pm_lock) != ESP_OK) {
+        buzzer_pm_lock = NULL;
     }
     
     // Configure GPIO
@@ -37,10 +201,11 @@ esp_err_t buzzer_init(void)
         .pull_up_en = GPIO_PULLUP_DISABLE,
     };
     
-    esp_err_t ret = gpio_config(&io_conf);
+    ret = gpio_config(&io_conf);
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "Failed to configure buzzer GPIO: %s", esp_err_to_name(ret));
-        vSemaphoreDelete(buzzer_mutex);
+        esp_timer_delete(buzzer_timer);
+        buzzer_timer = NULL;
         return ret;
     }
     
@@ -54,107 +219,69 @@ esp_err_t buzzer_init(void)
 
 esp_err_t buzzer_start_beep(int times, int duration)
 {
-    if (buzzer_mutex == NULL) {
+    if (buzzer_timer == NULL || times <= 0 || times > UINT8_MAX ||
+        duration <= 0 || duration > UINT16_MAX) {
         return ESP_FAIL;
     }
     
-    xSemaphoreTake(buzzer_mutex, portMAX_DELAY);
-    
-    // Stop any current beep sequence
-    beep_active = false;
-    gpio_set_level(BUZZER_PIN, 0);
-    buzzer_state = false;
+    // Equal on/off phases; the timer is stopped so the steps are not in use
+    portENTER_CRITICAL(&buzzer_lock);
+    if (!buzzer_may_preempt(PRIORITY_SIGNAL)) {
+        portEXIT_CRITICAL(&buzzer_lock);
+        return ESP_ERR_INVALID_STATE;
+    }
+    buzzer_cancel();
+    custom_steps[0] = (uint16_t)duration;
+    custom_steps[1] = (uint16_t)duration;
+    portEXIT_CRITICAL(&buzzer_lock);
     
-    // Set new beep parameters
-    beep_times = times;
-    beep_duration = duration;
-    beep_count = 0;
-    beep_start_time = esp_timer_get_time() / 1000;  // Convert to milliseconds
-    beep_active = true;
+    esp_err_t ret = buzzer_play_steps(custom_steps, 2, (uint8_t)times, PRIORITY_SIGNAL);
+    if (ret != ESP_OK) {
+        return ret;
+    }
     
-    // Start first beep
-    gpio_set_level(BUZZER_PIN, 1);
-    buzzer_state = true;
+    BINLOG(BEEP_START, times, duration);
+    return ESP_OK;
+}
+
+esp_err_t buzzer_play_pattern(buzzer_pattern_id_t id)
+{
+    if (buzzer_timer == NULL || id < 0 || id >= BUZZER_PATTERN_COUNT) {
+        return ESP_ERR_INVALID_ARG;
+    }
     
-    xSemaphoreGive(buzzer_mutex);
+    const buzzer_pattern_t *pattern = &patterns[id];
+    esp_err_t ret = buzzer_play_steps(pattern->steps, pattern->step_count, pattern->repeat, pattern->priority);
+    if (ret != ESP_OK) {
+        return ret;
+    }
     
-    ESP_LOGI(TAG, "Started beep sequence: %d times, %dms each", times, duration);
+    BINLOG(BEEP_PATTERN, id, BINLOG_STR(pattern->name));
     return ESP_OK;
 }
 
 esp_err_t buzzer_stop_beep(void)
 {
-    if (buzzer_mutex == NULL) {
+    if (buzzer_timer == NULL) {
         return ESP_FAIL;
     }
     
-    xSemaphoreTake(buzzer_mutex, portMAX_DELAY);
+    portENTER_CRITICAL(&buzzer_lock);
     
-    beep_active = false;
+    buzzer_cancel();
     gpio_set_level(BUZZER_PIN, 0);
     buzzer_state = false;
-    beep_count = 0;
+    buzzer_pm_hold(false);
     
-    xSemaphoreGive(buzzer_mutex);
+    portEXIT_CRITICAL(&buzzer_lock);
     
-    ESP_LOGI(TAG, "Buzzer stopped");
+    BINLOG(BEEP_STOP);
     return ESP_OK;
 }
 
 bool buzzer_is_active(void)
 {
-    if (buzzer_mutex == NULL) {
-        return false;
-    }
-    
-    xSemaphoreTake(buzzer_mutex, portMAX_DELAY);
-    bool active = beep_active;
-    xSemaphoreGive(buzzer_mutex);
-    
-    return active;
-}
-
-void buzzer_update(void)
-{
-    if (!beep_active || buzzer_mutex == NULL) {
-        return;
-    }
-    
-    xSemaphoreTake(buzzer_mutex, portMAX_DELAY);
-    
-    if (beep_active) {
-        uint64_t current_time = esp_timer_get_time() / 1000;  // Convert to milliseconds
-        uint64_t elapsed = current_time - beep_start_time;
-        
-        if (buzzer_state) {
-            // Currently beeping - check if time to stop
-            if (elapsed >= beep_duration) {
-                // Stop current beep
-                gpio_set_level(BUZZER_PIN, 0);
-                buzzer_state = false;
-                beep_count++;
-                beep_start_time = current_time;
-                
-                // ESP_LOGI(TAG, "Beep %d/%d completed", beep_count, beep_times);
-                
-                if (beep_count >= beep_times) {
-                    // All beeps completed
-                    beep_active = false;
-                    ESP_LOGI(TAG, "Beep sequence completed");
-                }
-            }
-        } else {
-            // Currently silent - check if time to start next beep
-            if (beep_count < beep_times && elapsed >= beep_duration) {
-                // Start next beep
-                gpio_set_level(BUZZER_PIN, 1);
-                buzzer_state = true;
-                beep_start_time = current_time;
-            }
-        }
-    }
-    
-    xSemaphoreGive(buzzer_mutex);
+    return beep_active;
 }
 
 esp_err_t buzzer_deinit(void)
@@ -165,12 +292,16 @@ esp_err_t buzzer_deinit(void)
     // Reset GPIO to default state
     gpio_reset_pin(BUZZER_PIN);
     
-    // Clean up mutex
-    if (buzzer_mutex) {
-        vSemaphoreDelete(buzzer_mutex);
-        buzzer_mutex = NULL;
+    // Clean up timer
+    if (buzzer_timer) {
+        esp_timer_delete(buzzer_timer);
+        buzzer_timer = NULL;
+    }
+    if (buzzer_pm_lock) {
+        esp_pm_lock_delete(buzzer_pm_lock);
+        buzzer_pm_lock = NULL;
     }
     
     ESP_LOGI(TAG, "Buzzer deinitialized");
     return ESP_OK;
-}
\ No newline at end of file
+}
@@ -4,6 +4,17 @@
 #include "esp_err.h"
 #include "driver/gpio.h"
 
+/**
+ * @brief Built-in buzzer patterns (see the pattern table in buzzer.c)
+ */
+typedef enum {
+    BUZZER_PATTERN_BEEP = 0,     // 5 x 300ms beeps
+    BUZZER_PATTERN_SHORT_LONG,   // Short-long alarm, 3 times
+    BUZZER_PATTERN_DOOR_AJAR,    // Double chirp reminder
+    BUZZER_PATTERN_ALARM,        // Repeats until buzzer_stop_beep()
+    BUZZER_PATTERN_COUNT
+} buzzer_pattern_id_t;
+
 /**
  * @brief Initialize buzzer
  * @return ESP_OK on success, error code on failure
@@ -12,12 +23,24 @@ esp_err_t buzzer_init(void);
 
 /**
  * @brief Start non-blocking beep sequence
+ * Phase edges are driven by a one-shot esp_timer; no polling is required.
+ * Has the lowest priority, so it never cuts off the alarm or the door-ajar reminder.
  * @param times Number of beeps
  * @param duration Duration of each beep in milliseconds
- * @return ESP_OK on success, error code on failure
+ * @return ESP_OK on success, ESP_ERR_INVALID_STATE while a higher-priority pattern plays,
+ *         ESP_FAIL for invalid arguments
  */
 esp_err_t buzzer_start_beep(int times, int duration);
 
+/**
+ * @brief Play a built-in pattern, replacing a current sequence of the same or lower priority
+ * Priorities, lowest first: beeps, door-ajar reminder, alarm. buzzer_stop_beep() stops any of them.
+ * @param id Pattern id
+ * @return ESP_OK on success, ESP_ERR_INVALID_STATE while a higher-priority pattern plays,
+ *         ESP_ERR_INVALID_ARG for an unknown id
+ */
+esp_err_t buzzer_play_pattern(buzzer_pattern_id_t id);
+
 /**
  * @brief Stop current beep sequence
  * @return ESP_OK on success, error code on failure
@@ -30,12 +53,6 @@ esp_err_t buzzer_stop_beep(void);
  */
 bool buzzer_is_active(void);
 
-/**
- * @brief Update buzzer state (call in main loop)
- * This function handles the non-blocking beep state machine
- */
-void buzzer_update(void);
-
 /**
  * @brief Deinitialize buzzer
  * @return ESP_OK on success, error code on failure
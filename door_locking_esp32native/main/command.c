@@ -0,0 +1,376 @@
+#include "command.h"
+#include "config.h"
+#include "buzzer.h"
+#include "telemetry.h"
+#include "settings.h"
+#include "publisher.h"
+#include "door_rules.h"
+#include "binlog.h"
+#include "ota.h"
+#include "boot_profile.h"
+#include "rtos_alloc.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include <string.h>
+#include <stdlib.h>
+
+static const char *TAG = "COMMAND";
+
+#define COMMAND_QUEUE_LEN   8
+#define COMMAND_HASH_SLOTS  256 // Power of two; collisions are probed linearly, at the cost of extra compares
+#define COMMAND_SLOT_EMPTY  0xFF
+
+#define COMMAND_FLAG_NAMED  0x01    // First argument is a name, passed in command_args_t.name
+
+typedef esp_err_t (*command_handler_t)(const command_args_t *args);
+
+typedef struct {
+    const char *name;
+    command_handler_t handler;
+    uint8_t min_args;       // Numeric arguments
+    uint8_t max_args;
+    uint8_t flags;
+} command_entry_t;
+
+typedef struct {
+    char data[COMMAND_MAX_LEN + 1];
+    uint8_t len;
+} command_msg_t;
+
+// ----------------- Command handlers -----------------
+static esp_err_t cmd_beep(const command_args_t *args)
+{
+    // BEEP [count] [duration_ms]
+    if (args->count == 0) {
+        return buzzer_play_pattern(BUZZER_PATTERN_BEEP);
+    }
+    int duration = args->count > 1 ? args->values[1] : settings_get()->beep_duration_ms;
+    return buzzer_start_beep(args->values[0], duration);
+}
+
+static esp_err_t cmd_stop(const command_args_t *args)
+{
+    return buzzer_stop_beep();
+}
+
+static esp_err_t cmd_pattern(const command_args_t *args)
+{
+    // PATTERN <id>
+    if (args->values[0] < 0 || args->values[0] >= BUZZER_PATTERN_COUNT) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    return buzzer_play_pattern((buzzer_pattern_id_t)args->values[0]);
+}
+
+static esp_err_t cmd_status(const command_args_t *args)
+{
+    return telemetry_publish();
+}
+
+static esp_err_t cmd_config(const command_args_t *args)
+{
+    char payload[SETTINGS_JSON_MAX];
+    size_t len = settings_format_json(payload, sizeof(payload));
+    if (len == 0) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    return publisher_publish(MQTT_TOPIC_CONFIG, payload, (int)len, true);
+}
+
+static esp_err_t cmd_set(const command_args_t *args)
+{
+    // SET <name> <value>
+    esp_err_t ret = settings_set(args->name, args->values[0]);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    
+    // Echo the new configuration; the setting is stored even if MQTT is down
+    cmd_config(args);
+    return ESP_OK;
+}
+
+static esp_err_t cmd_defaults(const command_args_t *args)
+{
+    esp_err_t ret = settings_reset();
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    
+    cmd_config(args);
+    return ESP_OK;
+}
+
+static esp_err_t cmd_arm(const command_args_t *args)
+{
+    esp_err_t ret = door_rules_arm(true);
+    if (ret == ESP_OK) {
+        door_rules_publish();
+    }
+    return ret;
+}
+
+static esp_err_t cmd_disarm(const command_args_t *args)
+{
+    esp_err_t ret = door_rules_arm(false);
+    if (ret == ESP_OK) {
+        door_rules_publish();
+    }
+    return ret;
+}
+
+static esp_err_t cmd_alerts(const command_args_t *args)
+{
+    return door_rules_publish();
+}
+
+static esp_err_t cmd_log(const command_args_t *args)
+{
+    // Formats the pending binary log records and publishes them as newline-separated batches;
+    // only the command worker runs this, so the buffer is kept off its stack
+    static char payload[1024];
+    size_t len = 0;
+    binlog_record_t record;
+    
+    while (binlog_read(&record)) {
+        char line[160];
+        size_t line_len = binlog_format(&record, line, sizeof(line));
+        if (len + line_len + 1 > sizeof(payload)) {
+            esp_err_t ret = publisher_publish(MQTT_TOPIC_LOG, payload, (int)len, false);
+            if (ret != ESP_OK) {
+                return ret;
+            }
+            len = 0;
+        }
+        memcpy(payload + len, line, line_len);
+        len += line_len;
+        payload[len++] = '\n';
+    }
+    
+    if (len == 0) {
+        return ESP_OK;
+    }
+    return publisher_publish(MQTT_TOPIC_LOG, payload, (int)len, false);
+}
+
+static esp_err_t cmd_loglevel(const command_args_t *args)
+{
+    // LOGLEVEL <module> <level>, level 0 (none) to 5 (verbose)
+    binlog_module_t module;
+    esp_err_t ret = binlog_module_from_name(args->name, &module);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    if (args->values[0] < ESP_LOG_NONE || args->values[0] > ESP_LOG_VERBOSE) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    return binlog_set_level(module, (esp_log_level_t)args->values[0]);
+}
+
+static esp_err_t cmd_ota(const command_args_t *args)
+{
+    return ota_start();
+}
+
+static esp_err_t cmd_profile(const command_args_t *args)
+{
+    static char payload[1536];   // Command worker only
+    size_t len = boot_profile_format_json(payload, sizeof(payload));
+    if (len == 0) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    
+    esp_err_t ret = publisher_publish(MQTT_TOPIC_PROFILE, payload, (int)len, true);
+    if (ret == ESP_OK) {
+        boot_profile_mark_published();
+    }
+    return ret;
+}
+
+static const command_entry_t commands[] = {
+    { "BEEP",     cmd_beep,     0, 2, 0 },
+    { "STOP",     cmd_stop,     0, 0, 0 },
+    { "PATTERN",  cmd_pattern,  1, 1, 0 },
+    { "STATUS",   cmd_status,   0, 0, 0 },
+    { "CONFIG",   cmd_config,   0, 0, 0 },
+    { "SET",      cmd_set,      1, 1, COMMAND_FLAG_NAMED },
+    { "DEFAULTS", cmd_defaults, 0, 0, 0 },
+    { "ARM",      cmd_arm,      0, 0, 0 },
+    { "DISARM",   cmd_disarm,   0, 0, 0 },
+    { "ALERTS",   cmd_alerts,   0, 0, 0 },
+    { "LOG",      cmd_log,      0, 0, 0 },
+    { "LOGLEVEL", cmd_loglevel, 1, 1, COMMAND_FLAG_NAMED },
+    { "OTA",      cmd_ota,      0, 0, 0 },
+    { "PROFILE",  cmd_profile,  0, 0, 0 },
+};
+
+#define COMMAND_COUNT (sizeof(commands) / sizeof(commands[0]))
+
+// A free slot always ends the probe sequence, and indexes stay below COMMAND_SLOT_EMPTY
+_Static_assert(COMMAND_COUNT < COMMAND_HASH_SLOTS && COMMAND_COUNT < COMMAND_SLOT_EMPTY,
+               "Too many commands for COMMAND_HASH_SLOTS");
+
+// Hash slot -> index into commands[]
+static uint8_t command_slots[COMMAND_HASH_SLOTS];
+static QueueHandle_t command_queue = NULL;
+RTOS_QUEUE_STORAGE(command, COMMAND_QUEUE_LEN, sizeof(command_msg_t));
+RTOS_TASK_STORAGE(command, CMD_TASK_STACK_SIZE);
+
+/**
+ * @brief FNV-1a hash of a command token
+ */
+static uint32_t command_hash(const char *token, size_t len)
+{
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= (uint8_t)token[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static const command_entry_t *command_lookup(const char *token, size_t len)
+{
+    uint32_t slot = command_hash(token, len) & (COMMAND_HASH_SLOTS - 1);
+    
+    // Usually the first slot decides; colliding names sit in the following slots
+    while (command_slots[slot] != COMMAND_SLOT_EMPTY) {
+        // Exact match only: "B" or an empty payload must not select BEEP
+        const command_entry_t *entry = &commands[command_slots[slot]];
+        if (strlen(entry->name) == len && memcmp(entry->name, token, len) == 0) {
+            return entry;
+        }
+        slot = (slot + 1) & (COMMAND_HASH_SLOTS - 1);
+    }
+    return NULL;
+}
+
+/**
+ * @brief Split "TOKEN [arg ...]" and dispatch it
+ */
+static void command_execute(char *line)
+{
+    char *save = NULL;
+    char *token = strtok_r(line, " \t\r\n", &save);
+    if (token == NULL) {
+        ESP_LOGW(TAG, "Empty command");
+        telemetry_count(TELEMETRY_COMMANDS_REJECTED);
+        return;
+    }
+    
+    const command_entry_t *entry = command_lookup(token, strlen(token));
+    if (entry == NULL) {
+        ESP_LOGW(TAG, "Unknown command: %s", token);
+        telemetry_count(TELEMETRY_COMMANDS_REJECTED);
+        return;
+    }
+    
+    command_args_t args = { .name = NULL, .count = 0 };
+    if (entry->flags & COMMAND_FLAG_NAMED) {
+        args.name = strtok_r(NULL, " \t\r\n", &save);
+        if (args.name == NULL) {
+            ESP_LOGW(TAG, "%s: missing name", entry->name);
+            telemetry_count(TELEMETRY_COMMANDS_REJECTED);
+            return;
+        }
+    }
+    
+    char *arg;
+    while ((arg = strtok_r(NULL, " \t\r\n", &save)) != NULL) {
+        char *end;
+        long value = strtol(arg, &end, 10);
+        if (*end != '\0' || args.count >= COMMAND_MAX_ARGS) {
+            ESP_LOGW(TAG, "%s: invalid argument \"%s\"", entry->name, arg);
+            telemetry_count(TELEMETRY_COMMANDS_REJECTED);
+            return;
+        }
+        args.values[args.count++] = (int32_t)value;
+    }
+    
+    if (args.count < entry->min_args || args.count > entry->max_args) {
+        ESP_LOGW(TAG, "%s: expected %u-%u arguments, got %u", entry->name,
+                 entry->min_args, entry->max_args, (unsigned)args.count);
+        telemetry_count(TELEMETRY_COMMANDS_REJECTED);
+        return;
+    }
+    
+    ESP_LOGI(TAG, "Command: %s (%u args)", entry->name, (unsigned)args.count);
+    esp_err_t ret = entry->handler(&args);
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "%s failed: %s", entry->name, esp_err_to_name(ret));
+        telemetry_count(TELEMETRY_COMMANDS_REJECTED);
+    } else {
+        telemetry_count(TELEMETRY_COMMANDS);
+    }
+}
+
+// ----------------- Command worker task -----------------
+static void command_task(void *pvParameters)
+{
+    command_msg_t msg;
+    
+    while (1) {
+        if (xQueueReceive(command_queue, &msg, portMAX_DELAY) == pdTRUE) {
+            msg.data[msg.len] = '\0';
+            command_execute(msg.data);
+        }
+    }
+}
+
+esp_err_t command_init(void)
+{
+    memset(command_slots, COMMAND_SLOT_EMPTY, sizeof(command_slots));
+    for (size_t i = 0; i < COMMAND_COUNT; i++) {
+        uint32_t slot = command_hash(commands[i].name, strlen(commands[i].name)) & (COMMAND_HASH_SLOTS - 1);
+        // Still dispatched correctly, only slower; a different COMMAND_HASH_SLOTS avoids it
+        if (command_slots[slot] != COMMAND_SLOT_EMPTY) {
+            ESP_LOGW(TAG, "Command %s collides with %s, probing", commands[i].name,
+                     commands[command_slots[slot]].name);
+        }
+        while (command_slots[slot] != COMMAND_SLOT_EMPTY) {
+            slot = (slot + 1) & (COMMAND_HASH_SLOTS - 1);
+        }
+        command_slots[slot] = (uint8_t)i;
+    }
+    
+    command_queue = rtos_queue_create(COMMAND_QUEUE_LEN, sizeof(command_msg_t), RTOS_QUEUE(command));
+    if (command_queue == NULL) {
+        ESP_LOGE(TAG, "Failed to create command queue");
+        return ESP_FAIL;
+    }
+    
+    esp_err_t ret = rtos_task_create(command_task, "command", CMD_TASK_STACK_SIZE, NULL,
+                                     CMD_TASK_PRIORITY, RTOS_CORE_NETWORK, RTOS_TASK(command), NULL);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to create command task");
+        vQueueDelete(command_queue);
+        command_queue = NULL;
+        return ESP_FAIL;
+    }
+    
+    ESP_LOGI(TAG, "Command dispatcher initialized (%u commands)", (unsigned)COMMAND_COUNT);
+    return ESP_OK;
+}
+
+esp_err_t command_submit(const char *data, int len)
+{
+    if (command_queue == NULL) {
+        return ESP_FAIL;
+    }
+    if (data == NULL || len <= 0 || len > COMMAND_MAX_LEN) {
+        ESP_LOGW(TAG, "Rejected command payload of %d bytes", len);
+        return ESP_ERR_INVALID_SIZE;
+    }
+    
+    command_msg_t msg;
+    memcpy(msg.data, data, len);
+    msg.len = (uint8_t)len;
+    
+    if (xQueueSend(command_queue, &msg, 0) != pdTRUE) {
+        ESP_LOGW(TAG, "Command queue full, dropped command");
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
@@ -0,0 +1,35 @@
+#ifndef COMMAND_H
+#define COMMAND_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+#define COMMAND_MAX_LEN     64  // Longest accepted command payload
+#define COMMAND_MAX_ARGS    4   // Numeric arguments after the command token
+
+/**
+ * @brief Parsed numeric arguments of a command
+ */
+typedef struct {
+    const char *name;           // Leading name argument of named commands (SET <name> ...), NULL otherwise
+    int32_t values[COMMAND_MAX_ARGS];
+    size_t count;
+} command_args_t;
+
+/**
+ * @brief Initialize the command table and start the command worker task
+ * @return ESP_OK on success, error code on failure
+ */
+esp_err_t command_init(void);
+
+/**
+ * @brief Queue a raw command payload ("TOKEN [arg ...]") for the worker task
+ * Copies the payload and never blocks, so it is safe to call from the MQTT event task.
+ * @param data Payload, not NUL-terminated
+ * @param len Payload length
+ * @return ESP_OK if queued, ESP_ERR_INVALID_SIZE if empty or too long, ESP_FAIL if the queue is full
+ */
+esp_err_t command_submit(const char *data, int len);
+
+#endif // COMMAND_H
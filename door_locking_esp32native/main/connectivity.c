@@ -0,0 +1,352 @@
+#include "connectivity.h"
+#include "config.h"
+#include "esp_log.h"
+#include "esp_wifi.h"
+#include "esp_timer.h"
+#include "esp_random.h"
+#include "freertos/FreeRTOS.h"
+
+static const char *TAG = "CONNECTIVITY";
+
+typedef enum {
+    LINK_DOWN = 0,
+    LINK_CONNECTING,
+    LINK_UP,
+} link_state_t;
+
+// Link state is written from the Wi-Fi event, MQTT and esp_timer tasks
+static portMUX_TYPE conn_lock = portMUX_INITIALIZER_UNLOCKED;
+static link_state_t wifi_link = LINK_DOWN;
+static link_state_t mqtt_link = LINK_DOWN;
+static bool mqtt_dropped = false;         // Torn down by the AP-gone path; its DISCONNECTED is expected
+static uint32_t wifi_failures = 0;
+static uint32_t mqtt_failures = 0;
+static uint32_t reconnects = 0;
+static uint8_t last_reason = 0;
+static int64_t retry_at_us = 0;           // Pending retry deadline, 0 if none
+static volatile conn_state_t reported_state = CONN_STATE_WIFI_DOWN;
+
+static esp_mqtt_client_handle_t mqtt_client = NULL;
+static esp_timer_handle_t retry_timer = NULL;
+static void (*state_callback)(conn_state_t previous, conn_state_t state) = NULL;
+
+static const char *const state_names[] = {
+    [CONN_STATE_WIFI_DOWN]       = "wifi_down",
+    [CONN_STATE_WIFI_CONNECTING] = "wifi_connecting",
+    [CONN_STATE_MQTT_DOWN]       = "mqtt_down",
+    [CONN_STATE_MQTT_CONNECTING] = "mqtt_connecting",
+    [CONN_STATE_ONLINE]          = "online",
+};
+
+/**
+ * @brief Combine both links into one state (caller holds conn_lock)
+ */
+static conn_state_t derive_state(void)
+{
+    if (wifi_link != LINK_UP) {
+        return wifi_link == LINK_CONNECTING ? CONN_STATE_WIFI_CONNECTING : CONN_STATE_WIFI_DOWN;
+    }
+    switch (mqtt_link) {
+        case LINK_UP:
+            return CONN_STATE_ONLINE;
+        case LINK_CONNECTING:
+            return CONN_STATE_MQTT_CONNECTING;
+        default:
+            return CONN_STATE_MQTT_DOWN;
+    }
+}
+
+/**
+ * @brief Publish the derived state and run the callback if it changed
+ */
+static void report_state(void)
+{
+    portENTER_CRITICAL(&conn_lock);
+    conn_state_t previous = reported_state;
+    conn_state_t state = derive_state();
+    reported_state = state;
+    portEXIT_CRITICAL(&conn_lock);
+    
+    if (state == previous) {
+        return;
+    }
+    
+    ESP_LOGI(TAG, "%s -> %s", state_names[previous], state_names[state]);
+    if (state_callback) {
+        state_callback(previous, state);
+    }
+}
+
+/**
+ * @brief Exponential backoff with equal jitter
+ * Half of the delay is fixed and half random, so devices that lost the same AP spread their retries.
+ */
+static uint32_t backoff_ms(uint32_t failures, uint32_t floor_ms)
+{
+    uint32_t ceiling = CONN_BACKOFF_MIN_MS;
+    while (failures-- > 0 && ceiling < CONN_BACKOFF_MAX_MS) {
+        ceiling *= 2;
+    }
+    if (ceiling < floor_ms) {
+        ceiling = floor_ms;
+    }
+    if (ceiling > CONN_BACKOFF_MAX_MS) {
+        ceiling = CONN_BACKOFF_MAX_MS;
+    }
+    
+    return ceiling / 2 + esp_random() % (ceiling / 2 + 1);
+}
+
+static void schedule_retry(uint32_t delay_ms)
+{
+    if (retry_timer == NULL) {
+        return;
+    }
+    
+    // A newer event always supersedes the pending retry
+    esp_timer_stop(retry_timer);
+    portENTER_CRITICAL(&conn_lock);
+    retry_at_us = esp_timer_get_time() + (int64_t)delay_ms * 1000;
+    portEXIT_CRITICAL(&conn_lock);
+    esp_timer_start_once(retry_timer, (uint64_t)delay_ms * 1000);
+}
+
+static void cancel_retry(void)
+{
+    if (retry_timer == NULL) {
+        return;
+    }
+    
+    esp_timer_stop(retry_timer);
+    portENTER_CRITICAL(&conn_lock);
+    retry_at_us = 0;
+    portEXIT_CRITICAL(&conn_lock);
+}
+
+/**
+ * @brief Run the retry for the lowest layer that is down
+ */
+static void retry_timer_callback(void *arg)
+{
+    portENTER_CRITICAL(&conn_lock);
+    retry_at_us = 0;
+    bool retry_wifi = wifi_link == LINK_DOWN;
+    bool retry_mqtt = wifi_link == LINK_UP && mqtt_link == LINK_DOWN && mqtt_client != NULL;
+    if (retry_wifi) {
+        wifi_link = LINK_CONNECTING;
+    } else if (retry_mqtt) {
+        mqtt_link = LINK_CONNECTING;
+    }
+    if (retry_wifi || retry_mqtt) {
+        reconnects++;
+    }
+    uint32_t attempt = (retry_wifi ? wifi_failures : mqtt_failures) + 1;
+    portEXIT_CRITICAL(&conn_lock);
+    report_state();
+    
+    if (retry_wifi) {
+        ESP_LOGI(TAG, "Reconnecting to Wi-Fi (attempt %lu)", (unsigned long)attempt);
+        esp_err_t ret = esp_wifi_connect();
+        if (ret != ESP_OK && ret != ESP_ERR_WIFI_CONN) {
+            // No disconnect event follows a rejected call, so count the failure here
+            ESP_LOGW(TAG, "esp_wifi_connect failed: %s", esp_err_to_name(ret));
+            connectivity_on_wifi_disconnected(last_reason);
+        }
+    } else if (retry_mqtt) {
+        ESP_LOGI(TAG, "Reconnecting to MQTT broker (attempt %lu)", (unsigned long)attempt);
+        // Fails if the client is already mid-connect; its own CONNECTED/DISCONNECTED event follows
+        if (esp_mqtt_client_reconnect(mqtt_client) != ESP_OK) {
+            ESP_LOGD(TAG, "MQTT client not waiting for reconnect");
+        }
+    }
+}
+
+esp_err_t connectivity_init(void)
+{
+    if (retry_timer != NULL) {
+        return ESP_OK;
+    }
+    
+    const esp_timer_create_args_t timer_args = {
+        .callback = retry_timer_callback,
+        .arg = NULL,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "conn_retry",
+    };
+    
+    esp_err_t ret = esp_timer_create(&timer_args, &retry_timer);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to create retry timer: %s", esp_err_to_name(ret));
+        return ret;
+    }
+    
+    ESP_LOGI(TAG, "Reconnect backoff %lu..%lums (AP gone: from %lums)",
+             (unsigned long)CONN_BACKOFF_MIN_MS, (unsigned long)CONN_BACKOFF_MAX_MS,
+             (unsigned long)CONN_AP_GONE_DELAY_MS);
+    return ESP_OK;
+}
+
+void connectivity_deinit(void)
+{
+    if (retry_timer != NULL) {
+        esp_timer_stop(retry_timer);
+        esp_timer_delete(retry_timer);
+        retry_timer = NULL;
+    }
+}
+
+void connectivity_set_mqtt_client(esp_mqtt_client_handle_t client)
+{
+    portENTER_CRITICAL(&conn_lock);
+    mqtt_client = client;
+    mqtt_link = client != NULL ? LINK_CONNECTING : LINK_DOWN;
+    portEXIT_CRITICAL(&conn_lock);
+    report_state();
+}
+
+void connectivity_set_state_callback(void (*callback)(conn_state_t previous, conn_state_t state))
+{
+    state_callback = callback;
+}
+
+// ----------------- Wi-Fi layer -----------------
+void connectivity_on_wifi_started(void)
+{
+    portENTER_CRITICAL(&conn_lock);
+    wifi_link = LINK_CONNECTING;
+    portEXIT_CRITICAL(&conn_lock);
+    report_state();
+    
+    esp_wifi_connect();
+}
+
+void connectivity_on_wifi_disconnected(uint8_t reason)
+{
+    // The AP vanished rather than refusing us: the TCP session is dead and the AP needs time to return
+    bool ap_gone = reason == WIFI_REASON_BEACON_TIMEOUT || reason == WIFI_REASON_NO_AP_FOUND;
+    
+    portENTER_CRITICAL(&conn_lock);
+    bool was_up = wifi_link == LINK_UP;
+    wifi_link = LINK_DOWN;
+    last_reason = reason;
+    
+    // Losing a working link is not a failed attempt; the first retry uses the shortest delay
+    if (!was_up) {
+        wifi_failures++;
+    }
+    uint32_t failures = wifi_failures;
+    
+    // Short outages and roams can keep the MQTT socket; an AP that is gone cannot
+    bool drop_mqtt = ap_gone && mqtt_link != LINK_DOWN && mqtt_client != NULL;
+    if (drop_mqtt) {
+        mqtt_link = LINK_DOWN;
+        mqtt_dropped = true;
+    }
+    portEXIT_CRITICAL(&conn_lock);
+    
+    uint32_t delay_ms = backoff_ms(failures, ap_gone ? CONN_AP_GONE_DELAY_MS : 0);
+    schedule_retry(delay_ms);
+    report_state();
+    
+    ESP_LOGW(TAG, "Wi-Fi disconnected (reason %u%s), retry in %lums",
+             reason, ap_gone ? ", AP gone" : "", (unsigned long)delay_ms);
+    
+    // Close the socket now instead of waiting 1.5 keepalives for the broker timeout
+    if (drop_mqtt) {
+        esp_mqtt_client_disconnect(mqtt_client);
+    }
+}
+
+void connectivity_on_wifi_got_ip(void)
+{
+    portENTER_CRITICAL(&conn_lock);
+    wifi_link = LINK_UP;
+    wifi_failures = 0;
+    bool retry_mqtt = mqtt_client != NULL && mqtt_link == LINK_DOWN;
+    uint32_t failures = mqtt_failures;
+    portEXIT_CRITICAL(&conn_lock);
+    
+    // Jittered even on the first attempt, so a fleet behind a rebooted AP does not hit the broker at once
+    if (retry_mqtt) {
+        schedule_retry(backoff_ms(failures, 0));
+    } else {
+        cancel_retry();
+    }
+    report_state();
+}
+
+// ----------------- MQTT layer -----------------
+void connectivity_on_mqtt_connected(void)
+{
+    portENTER_CRITICAL(&conn_lock);
+    mqtt_link = LINK_UP;
+    mqtt_dropped = false;
+    mqtt_failures = 0;
+    bool wifi_up = wifi_link == LINK_UP;
+    portEXIT_CRITICAL(&conn_lock);
+    
+    if (wifi_up) {
+        cancel_retry();
+    }
+    report_state();
+}
+
+void connectivity_on_mqtt_disconnected(void)
+{
+    portENTER_CRITICAL(&conn_lock);
+    bool expected = mqtt_dropped;
+    bool was_up = mqtt_link == LINK_UP;
+    bool wifi_up = wifi_link == LINK_UP;
+    mqtt_dropped = false;
+    mqtt_link = LINK_DOWN;
+    
+    // Broker failures only count while the network is there; otherwise Wi-Fi owns the backoff
+    if (!expected && !was_up && wifi_up) {
+        mqtt_failures++;
+    }
+    uint32_t failures = mqtt_failures;
+    portEXIT_CRITICAL(&conn_lock);
+    
+    if (!expected && wifi_up) {
+        uint32_t delay_ms = backoff_ms(failures, 0);
+        schedule_retry(delay_ms);
+        ESP_LOGW(TAG, "MQTT disconnected, retry in %lums", (unsigned long)delay_ms);
+    }
+    report_state();
+}
+
+// ----------------- State -----------------
+conn_state_t connectivity_get_state(void)
+{
+    return reported_state;
+}
+
+bool connectivity_is_online(void)
+{
+    return reported_state == CONN_STATE_ONLINE;
+}
+
+void connectivity_get_status(conn_status_t *status)
+{
+    if (status == NULL) {
+        return;
+    }
+    
+    int64_t now = esp_timer_get_time();
+    portENTER_CRITICAL(&conn_lock);
+    status->state = reported_state;
+    status->wifi_failures = wifi_failures;
+    status->mqtt_failures = mqtt_failures;
+    status->reconnects = reconnects;
+    status->next_retry_ms = (retry_at_us > now) ? (uint32_t)((retry_at_us - now) / 1000) : 0;
+    status->last_reason = last_reason;
+    portEXIT_CRITICAL(&conn_lock);
+}
+
+const char *connectivity_state_name(conn_state_t state)
+{
+    if (state > CONN_STATE_ONLINE) {
+        return "unknown";
+    }
+    return state_names[state];
+}
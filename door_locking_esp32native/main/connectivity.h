@@ -0,0 +1,106 @@
+#ifndef CONNECTIVITY_H
+#define CONNECTIVITY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "mqtt_client.h"
+
+/**
+ * @brief Combined Wi-Fi and MQTT link state, lowest layer first
+ */
+typedef enum {
+    CONN_STATE_WIFI_DOWN = 0,    // Not associated, a retry is scheduled
+    CONN_STATE_WIFI_CONNECTING,  // Association or DHCP in progress
+    CONN_STATE_MQTT_DOWN,        // IP obtained, broker not connected, a retry is scheduled
+    CONN_STATE_MQTT_CONNECTING,  // TCP/TLS/MQTT handshake in progress
+    CONN_STATE_ONLINE,           // Broker connected
+} conn_state_t;
+
+/**
+ * @brief Snapshot of the reconnect controller, for diagnostics
+ */
+typedef struct {
+    conn_state_t state;
+    uint32_t wifi_failures;      // Consecutive failed Wi-Fi attempts (backoff exponent)
+    uint32_t mqtt_failures;      // Consecutive failed MQTT attempts (backoff exponent)
+    uint32_t reconnects;         // Scheduled retries issued since boot
+    uint32_t next_retry_ms;      // Time until the pending retry, 0 if none
+    uint8_t last_reason;         // wifi_err_reason_t of the last disconnect
+} conn_status_t;
+
+/**
+ * @brief Create the retry timer; called by wifi_init() before Wi-Fi starts
+ * @return ESP_OK on success, error code on failure
+ */
+esp_err_t connectivity_init(void);
+
+/**
+ * @brief Stop pending retries and delete the retry timer
+ */
+void connectivity_deinit(void);
+
+/**
+ * @brief Hand the started MQTT client to the controller, which then schedules its reconnects
+ * @param client MQTT client handle
+ */
+void connectivity_set_mqtt_client(esp_mqtt_client_handle_t client);
+
+/**
+ * @brief Register a callback for state changes (runs in the Wi-Fi, MQTT or esp_timer task)
+ * @param callback Called with the previous and the new state
+ */
+void connectivity_set_state_callback(void (*callback)(conn_state_t previous, conn_state_t state));
+
+/**
+ * @brief WIFI_EVENT_STA_START: make the first connection attempt
+ */
+void connectivity_on_wifi_started(void);
+
+/**
+ * @brief WIFI_EVENT_STA_DISCONNECTED: schedule the next attempt with backoff
+ * @param reason wifi_err_reason_t from the disconnect event
+ */
+void connectivity_on_wifi_disconnected(uint8_t reason);
+
+/**
+ * @brief IP_EVENT_STA_GOT_IP: reset the Wi-Fi backoff and schedule MQTT if it is down
+ */
+void connectivity_on_wifi_got_ip(void);
+
+/**
+ * @brief MQTT_EVENT_CONNECTED: reset the MQTT backoff
+ */
+void connectivity_on_mqtt_connected(void);
+
+/**
+ * @brief MQTT_EVENT_DISCONNECTED: schedule the next broker attempt with backoff
+ */
+void connectivity_on_mqtt_disconnected(void);
+
+/**
+ * @brief Get the current link state
+ * @return Connectivity state
+ */
+conn_state_t connectivity_get_state(void);
+
+/**
+ * @brief Check if the broker is reachable
+ * @return true if CONN_STATE_ONLINE, false otherwise
+ */
+bool connectivity_is_online(void);
+
+/**
+ * @brief Get controller state and backoff counters
+ * @param status Output status
+ */
+void connectivity_get_status(conn_status_t *status);
+
+/**
+ * @brief Short name of a state, for logs and the console
+ * @param state Connectivity state
+ * @return State name
+ */
+const char *connectivity_state_name(conn_state_t state);
+
+#endif // CONNECTIVITY_H
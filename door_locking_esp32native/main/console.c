@@ -0,0 +1,297 @@
+#include "console.h"
+#include "config.h"
+#include "trace.h"
+#include "hall_sensor.h"
+#include "settings.h"
+#include "rtos_alloc.h"
+#include "connectivity.h"
+#include "event_bus.h"
+#include "led.h"
+#include "binlog.h"
+#include "espnow_gateway.h"
+#include "esp_console.h"
+#include "esp_log.h"
+#include "esp_system.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+static const char *TAG = "CONSOLE";
+
+// ----------------- Commands -----------------
+static int cmd_trace(int argc, char **argv)
+{
+    if (argc > 1 && strcmp(argv[1], "reset") == 0) {
+        trace_reset();
+        printf("Trace histograms cleared\n");
+        return 0;
+    }
+    
+    for (int stage = 0; stage < TRACE_STAGE_COUNT; stage++) {
+        trace_histogram_t histogram;
+        trace_get_histogram(stage, &histogram);
+        
+        printf("%s: n=%lu avg=%luus max=%luus\n", trace_stage_name(stage),
+               (unsigned long)histogram.count,
+               (unsigned long)(histogram.count ? histogram.sum_us / histogram.count : 0),
+               (unsigned long)histogram.max_us);
+        for (int i = 0; i < TRACE_BUCKET_COUNT; i++) {
+            if (histogram.buckets[i] == 0) {
+                continue;
+            }
+            if (i == TRACE_BUCKET_COUNT - 1) {
+                printf("  >= %8luus: %lu\n", (unsigned long)(TRACE_BUCKET_BASE_US / 2) << i,
+                       (unsigned long)histogram.buckets[i]);
+            } else {
+                printf("  <  %8luus: %lu\n", (unsigned long)TRACE_BUCKET_BASE_US << i,
+                       (unsigned long)histogram.buckets[i]);
+            }
+        }
+    }
+    
+    printf("queue dropped: %lu, ack lost: %lu, edge ring overflows: %lu\n",
+           (unsigned long)trace_get_count(TRACE_QUEUE_DROPPED),
+           (unsigned long)trace_get_count(TRACE_ACK_LOST),
+           (unsigned long)hall_sensor_get_overflow_count());
+    return 0;
+}
+
+static int cmd_hall(int argc, char **argv)
+{
+    for (size_t ch = 0; ch < hall_sensor_get_channel_count(); ch++) {
+        const hall_channel_config_t *config = hall_sensor_get_channel(ch);
+        hall_channel_stats_t stats;
+        if (hall_sensor_get_stats(ch, &stats) != ESP_OK) {
+            continue;
+        }
+        
+        printf("%u \"%s\" (GPIO %d, %ums): %s, %lu transitions, %lu bounces, %lu glitches, "
+               "settle last %luus max %luus\n",
+               (unsigned)ch, config->id, config->pin,
+               settings_get()->debounce_ms ? settings_get()->debounce_ms : config->debounce_ms,
+               (hall_sensor_get_last_state() & (1u << ch)) ? "OPEN" : "CLOSED",
+               (unsigned long)stats.transitions, (unsigned long)stats.bounces,
+               (unsigned long)stats.glitches, (unsigned long)stats.last_settle_us,
+               (unsigned long)stats.max_settle_us);
+    }
+    return 0;
+}
+
+static int cmd_tasks(int argc, char **argv)
+{
+    rtos_task_stats_t stats;
+    for (size_t i = 0; rtos_task_get_stats(i, &stats) == ESP_OK; i++) {
+        printf("%-14s core %c, stack %5lu, peak use %5lu, free %5lu\n", stats.name,
+               stats.core_id == tskNO_AFFINITY ? '-' : (char)('0' + stats.core_id),
+               (unsigned long)stats.stack_size,
+               (unsigned long)(stats.stack_size - stats.high_water_mark),
+               (unsigned long)stats.high_water_mark);
+    }
+    printf("%s allocation, heap free %lu, min %lu\n", RTOS_STATIC_ALLOCATION ? "static" : "dynamic",
+           (unsigned long)esp_get_free_heap_size(), (unsigned long)esp_get_minimum_free_heap_size());
+    return 0;
+}
+
+static int cmd_net(int argc, char **argv)
+{
+    conn_status_t status;
+    connectivity_get_status(&status);
+    
+    printf("%s, wifi failures %lu, mqtt failures %lu, last reason %u, %lu reconnects\n",
+           connectivity_state_name(status.state),
+           (unsigned long)status.wifi_failures, (unsigned long)status.mqtt_failures,
+           status.last_reason, (unsigned long)status.reconnects);
+    if (status.next_retry_ms > 0) {
+        printf("next retry in %lums\n", (unsigned long)status.next_retry_ms);
+    }
+    printf("led: %s (status 0x%02lx)\n", led_get_pattern_name(), (unsigned long)led_get_status());
+    return 0;
+}
+
+static int cmd_bus(int argc, char **argv)
+{
+    event_bus_stats_t stats;
+    for (size_t i = 0; event_bus_get_stats(i, &stats) == ESP_OK; i++) {
+        printf("%-10s delivered %lu, dropped %lu, queued %lu/%lu\n", stats.name,
+               (unsigned long)stats.delivered, (unsigned long)stats.dropped,
+               (unsigned long)stats.waiting, (unsigned long)stats.length);
+    }
+    return 0;
+}
+
+static int cmd_nodes(int argc, char **argv)
+{
+    if (!ESPNOW_GATEWAY_ENABLE) {
+        printf("ESP-NOW gateway disabled\n");
+        return 0;
+    }
+    
+    espnow_node_stats_t stats;
+    for (size_t i = 0; espnow_gateway_get_stats(i, &stats) == ESP_OK; i++) {
+        if (!stats.known) {
+            printf("%-16s no state received\n", stats.id);
+            continue;
+        }
+        printf("%-16s %s, seq %lu, %d dBm, %lu frames, %lu repeated, last at %lus\n", stats.id,
+               stats.open ? "OPEN" : "CLOSED", (unsigned long)stats.last_seq, stats.rssi,
+               (unsigned long)stats.frames, (unsigned long)stats.duplicates, (unsigned long)stats.last_seen_s);
+    }
+    printf("%lu frames rejected\n", (unsigned long)espnow_gateway_get_rejected());
+    return 0;
+}
+
+static const char *const level_names[] = { "none", "error", "warn", "info", "debug", "verbose" };
+
+static int log_print_levels(void)
+{
+    for (size_t module = 0; module < BINLOG_MODULE_COUNT; module++) {
+        printf("%-12s %s\n", binlog_module_name(module), level_names[binlog_get_level(module)]);
+    }
+    return 0;
+}
+
+static int log_set_level(const char *name, const char *level_arg)
+{
+    binlog_module_t module;
+    if (binlog_module_from_name(name, &module) != ESP_OK) {
+        printf("Unknown module %s\n", name);
+        return 1;
+    }
+    
+    // Level by name or number
+    for (size_t level = 0; level < sizeof(level_names) / sizeof(level_names[0]); level++) {
+        if (strcmp(level_arg, level_names[level]) == 0) {
+            return binlog_set_level(module, (esp_log_level_t)level) == ESP_OK ? log_print_levels() : 1;
+        }
+    }
+    char *end;
+    long level = strtol(level_arg, &end, 10);
+    if (*end != '\0' || binlog_set_level(module, (esp_log_level_t)level) != ESP_OK) {
+        printf("Invalid level %s\n", level_arg);
+        return 1;
+    }
+    return log_print_levels();
+}
+
+static int log_print_flash(void)
+{
+    static binlog_record_t records[BINLOG_FLASH_RECORDS];
+    size_t count;
+    esp_err_t ret = binlog_load_from_flash(records, BINLOG_FLASH_RECORDS, &count);
+    if (ret != ESP_OK) {
+        printf("No usable snapshot: %s\n", esp_err_to_name(ret));
+        return 1;
+    }
+    
+    char line[160];
+    for (size_t i = 0; i < count; i++) {
+        binlog_format(&records[i], line, sizeof(line));
+        printf("%s\n", line);
+    }
+    printf("%u saved records\n", (unsigned)count);
+    return 0;
+}
+
+static int cmd_log(int argc, char **argv)
+{
+    if (argc > 1 && strcmp(argv[1], "level") == 0) {
+        return argc > 3 ? log_set_level(argv[2], argv[3]) : log_print_levels();
+    }
+    if (argc > 1 && strcmp(argv[1], "save") == 0) {
+        return binlog_save_to_flash() == ESP_OK ? 0 : 1;
+    }
+    if (argc > 1 && strcmp(argv[1], "flash") == 0) {
+        return log_print_flash();
+    }
+    
+    binlog_stats_t stats;
+    binlog_get_stats(&stats);
+    size_t count = binlog_drain_to_uart();
+    printf("%u records drained, %lu written, %lu overwritten\n", (unsigned)count,
+           (unsigned long)stats.written, (unsigned long)stats.overwritten);
+    return 0;
+}
+
+static const esp_console_cmd_t console_commands[] = {
+    {
+        .command = "trace",
+        .help = "Print door event latency histograms, 'trace reset' clears them",
+        .hint = "[reset]",
+        .func = cmd_trace,
+    },
+    {
+        .command = "tasks",
+        .help = "Print stack size and high-water mark of the application tasks",
+        .hint = NULL,
+        .func = cmd_tasks,
+    },
+    {
+        .command = "bus",
+        .help = "Print door event bus subscribers with delivered and dropped counts",
+        .hint = NULL,
+        .func = cmd_bus,
+    },
+    {
+        .command = "nodes",
+        .help = "Print ESP-NOW sensor nodes forwarded by the gateway with their last state",
+        .hint = NULL,
+        .func = cmd_nodes,
+    },
+    {
+        .command = "net",
+        .help = "Print WiFi/MQTT connectivity state, reconnect backoff and LED pattern",
+        .hint = NULL,
+        .func = cmd_net,
+    },
+    {
+        .command = "log",
+        .help = "Drain the binary log; 'log level [module level]' shows or sets verbosity, "
+                "'log save' copies the newest records to flash, 'log flash' prints them",
+        .hint = "[level [<module> <level>] | save | flash]",
+        .func = cmd_log,
+    },
+    {
+        .command = "hall",
+        .help = "Print per-channel Hall sensor debounce statistics",
+        .hint = NULL,
+        .func = cmd_hall,
+    },
+};
+
+esp_err_t console_init(void)
+{
+    esp_console_repl_t *repl = NULL;
+    esp_console_repl_config_t repl_config = ESP_CONSOLE_REPL_CONFIG_DEFAULT();
+    repl_config.prompt = "lock>";
+    repl_config.task_core_id = RTOS_CORE_NETWORK;
+    esp_err_t ret;
+    
+#if defined(CONFIG_ESP_CONSOLE_USB_SERIAL_JTAG)
+    esp_console_dev_usb_serial_jtag_config_t hw_config = ESP_CONSOLE_DEV_USB_SERIAL_JTAG_CONFIG_DEFAULT();
+    ret = esp_console_new_repl_usb_serial_jtag(&hw_config, &repl_config, &repl);
+#else
+    esp_console_dev_uart_config_t hw_config = ESP_CONSOLE_DEV_UART_CONFIG_DEFAULT();
+    ret = esp_console_new_repl_uart(&hw_config, &repl_config, &repl);
+#endif
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to create console REPL: %s", esp_err_to_name(ret));
+        return ret;
+    }
+    
+    for (size_t i = 0; i < sizeof(console_commands) / sizeof(console_commands[0]); i++) {
+        ret = esp_console_cmd_register(&console_commands[i]);
+        if (ret != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to register '%s': %s", console_commands[i].command, esp_err_to_name(ret));
+            return ret;
+        }
+    }
+    
+    ret = esp_console_start_repl(repl);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to start console REPL: %s", esp_err_to_name(ret));
+        return ret;
+    }
+    
+    ESP_LOGI(TAG, "Console started");
+    return ESP_OK;
+}
@@ -0,0 +1,13 @@
+#ifndef CONSOLE_H
+#define CONSOLE_H
+
+#include "esp_err.h"
+
+/**
+ * @brief Start the serial console REPL with the diagnostic commands
+ * Commands: "trace [reset]" (latency histograms), "hall" (per-channel debounce statistics).
+ * @return ESP_OK on success, error code on failure
+ */
+esp_err_t console_init(void);
+
+#endif // CONSOLE_H
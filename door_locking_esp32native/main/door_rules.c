@@ -0,0 +1,267 @@
+#include "door_rules.h"
+#include "config.h"
+#include "event_bus.h"
+#include "hall_sensor.h"
+#include "buzzer.h"
+#include "led.h"
+#include "settings.h"
+#include "publisher.h"
+#include "command.h"
+#include "outbox.h"
+#include "rtos_alloc.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "nvs.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <stdio.h>
+
+static const char *TAG = "DOOR_RULES";
+
+#define RULES_QUEUE_LEN     8
+#define RULES_NVS_NS        "rules"
+#define RULES_NVS_KEY_ARMED "armed"
+
+static const char *const alert_names[] = {
+    [DOOR_ALERT_NONE]         = "none",
+    [DOOR_ALERT_AJAR]         = "door_ajar",
+    [DOOR_ALERT_AJAR_CLEARED] = "door_ajar_cleared",
+    [DOOR_ALERT_ALARM]        = "alarm",
+    [DOOR_ALERT_ARMED]        = "armed",
+    [DOOR_ALERT_DISARMED]     = "disarmed",
+};
+
+// Written from the rules task, the esp_timer task and the command worker
+static portMUX_TYPE rules_lock = portMUX_INITIALIZER_UNLOCKED;
+static door_rules_state_t state;
+
+// One-shot ajar deadline per channel, armed while the channel is open
+static esp_timer_handle_t ajar_timers[HALL_MAX_CHANNELS];
+static size_t channel_count = 0;
+
+static QueueHandle_t rules_queue = NULL;
+RTOS_QUEUE_STORAGE(rules, RULES_QUEUE_LEN, sizeof(bus_event_t));
+RTOS_TASK_STORAGE(rules, RULES_TASK_STACK_SIZE);
+
+// Called with rules_lock held
+static void set_last_alert(door_alert_t alert, uint8_t channel)
+{
+    state.last_alert = alert;
+    state.last_channel = channel;
+}
+
+static void ajar_deadline_start(uint8_t channel)
+{
+    uint32_t timeout_s = settings_get()->ajar_timeout_s;
+    esp_timer_stop(ajar_timers[channel]);
+    if (timeout_s > 0) {
+        esp_timer_start_once(ajar_timers[channel], (uint64_t)timeout_s * 1000000ULL);
+    }
+}
+
+/**
+ * @brief Ajar deadline expired (esp_timer task context)
+ * Local alerts are raised here; the MQTT publish is handed to the command worker.
+ */
+static void ajar_timer_callback(void *arg)
+{
+    uint8_t channel = (uint8_t)(uintptr_t)arg;
+    
+    portENTER_CRITICAL(&rules_lock);
+    // The close that should have stopped the timer may have raced its expiry
+    if (!(state.open_mask & (1u << channel))) {
+        portEXIT_CRITICAL(&rules_lock);
+        return;
+    }
+    state.ajar_mask |= 1u << channel;
+    set_last_alert(DOOR_ALERT_AJAR, channel);
+    bool alarm_active = state.alarm_mask != 0;
+    portEXIT_CRITICAL(&rules_lock);
+    
+    // A sounding alarm is not interrupted by the reminder
+    if (!alarm_active) {
+        buzzer_play_pattern(BUZZER_PATTERN_DOOR_AJAR);
+    }
+    ESP_LOGW(TAG, "Channel %u open for %lus", channel, (unsigned long)settings_get()->ajar_timeout_s);
+    command_submit("ALERTS", 6);
+}
+
+/**
+ * @brief Evaluate the rules for one transition (rules task)
+ * @return Alert to publish, DOOR_ALERT_NONE if nothing changed
+ */
+static door_alert_t rules_evaluate(const hall_event_t *event)
+{
+    uint32_t bit = 1u << event->channel;
+    door_alert_t alert = DOOR_ALERT_NONE;
+    
+    if (event->open) {
+        ajar_deadline_start(event->channel);
+        
+        portENTER_CRITICAL(&rules_lock);
+        state.open_mask |= bit;
+        bool raise = state.armed && !(state.alarm_mask & bit);
+        bool first = state.alarm_mask == 0;
+        if (raise) {
+            state.alarm_mask |= bit;
+            set_last_alert(DOOR_ALERT_ALARM, event->channel);
+            alert = DOOR_ALERT_ALARM;
+        }
+        portEXIT_CRITICAL(&rules_lock);
+        
+        if (raise && first) {
+            buzzer_play_pattern(BUZZER_PATTERN_ALARM);
+            led_update(LED_STATUS_ALARM, LED_STATUS_ALARM);
+        }
+    } else {
+        esp_timer_stop(ajar_timers[event->channel]);
+        
+        portENTER_CRITICAL(&rules_lock);
+        state.open_mask &= ~bit;
+        if (state.ajar_mask & bit) {
+            state.ajar_mask &= ~bit;
+            set_last_alert(DOOR_ALERT_AJAR_CLEARED, event->channel);
+            alert = DOOR_ALERT_AJAR_CLEARED;
+        }
+        portEXIT_CRITICAL(&rules_lock);
+    }
+    
+    return alert;
+}
+
+// ----------------- Rules task -----------------
+static void rules_task(void *pvParameters)
+{
+    bus_event_t event;
+    
+    while (1) {
+        xQueueReceive(rules_queue, &event, portMAX_DELAY);
+        
+        door_alert_t alert = rules_evaluate(&event.door);
+        if (alert != DOOR_ALERT_NONE) {
+            ESP_LOGW(TAG, "Channel %u: %s", event.door.channel, alert_names[alert]);
+            // Offline alerts stay local; the retained state is republished on reconnect
+            door_rules_publish();
+        }
+    }
+}
+
+static bool load_armed(void)
+{
+    nvs_handle_t nvs;
+    uint8_t armed = 0;
+    if (nvs_open(RULES_NVS_NS, NVS_READONLY, &nvs) == ESP_OK) {
+        nvs_get_u8(nvs, RULES_NVS_KEY_ARMED, &armed);
+        nvs_close(nvs);
+    }
+    return armed != 0;
+}
+
+esp_err_t door_rules_init(void)
+{
+    channel_count = hall_sensor_get_channel_count();
+    state.armed = load_armed();
+    
+    for (size_t ch = 0; ch < channel_count; ch++) {
+        const esp_timer_create_args_t timer_args = {
+            .callback = ajar_timer_callback,
+            .arg = (void *)(uintptr_t)ch,
+            .dispatch_method = ESP_TIMER_TASK,
+            .name = "door_ajar",
+        };
+        esp_err_t ret = esp_timer_create(&timer_args, &ajar_timers[ch]);
+        if (ret != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to create ajar timer: %s", esp_err_to_name(ret));
+            return ret;
+        }
+        
+        // The debouncer reports every channel as open at boot: a door already open counts from now,
+        // a closed one stops its deadline once the first stable window reports the close
+        state.open_mask |= 1u << ch;
+        ajar_deadline_start(ch);
+    }
+    
+    rules_queue = event_bus_subscribe("rules", RULES_QUEUE_LEN, RTOS_QUEUE(rules));
+    if (rules_queue == NULL) {
+        ESP_LOGE(TAG, "Failed to subscribe to door events");
+        return ESP_FAIL;
+    }
+    
+    esp_err_t ret = rtos_task_create(rules_task, "rules", RULES_TASK_STACK_SIZE, NULL,
+                                     RULES_TASK_PRIORITY, RTOS_CORE_NETWORK, RTOS_TASK(rules), NULL);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to create rules task");
+        return ESP_FAIL;
+    }
+    
+    ESP_LOGI(TAG, "Door rules initialized (%s, ajar after %lus)", state.armed ? "armed" : "disarmed",
+             (unsigned long)settings_get()->ajar_timeout_s);
+    return ESP_OK;
+}
+
+esp_err_t door_rules_arm(bool armed)
+{
+    nvs_handle_t nvs;
+    esp_err_t ret = nvs_open(RULES_NVS_NS, NVS_READWRITE, &nvs);
+    if (ret == ESP_OK) {
+        ret = nvs_set_u8(nvs, RULES_NVS_KEY_ARMED, armed ? 1 : 0);
+        if (ret == ESP_OK) {
+            ret = nvs_commit(nvs);
+        }
+        nvs_close(nvs);
+    }
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to store armed state: %s", esp_err_to_name(ret));
+        return ret;
+    }
+    
+    portENTER_CRITICAL(&rules_lock);
+    bool silence = !armed && state.alarm_mask != 0;
+    state.armed = armed;
+    if (!armed) {
+        state.alarm_mask = 0;
+    }
+    set_last_alert(armed ? DOOR_ALERT_ARMED : DOOR_ALERT_DISARMED, 0);
+    portEXIT_CRITICAL(&rules_lock);
+    
+    if (silence) {
+        buzzer_stop_beep();
+        led_update(LED_STATUS_ALARM, 0);
+    }
+    
+    ESP_LOGI(TAG, "%s", armed ? "Armed" : "Disarmed");
+    return ESP_OK;
+}
+
+void door_rules_get_state(door_rules_state_t *out)
+{
+    if (out == NULL) {
+        return;
+    }
+    
+    portENTER_CRITICAL(&rules_lock);
+    *out = state;
+    portEXIT_CRITICAL(&rules_lock);
+}
+
+esp_err_t door_rules_publish(void)
+{
+    door_rules_state_t current;
+    door_rules_get_state(&current);
+    
+    char payload[160];
+    int len = snprintf(payload, sizeof(payload),
+                       "{\"armed\":%d,\"alarm_mask\":%lu,\"ajar_mask\":%lu,\"last\":\"%s\",\"channel\":%u,\"boot\":%u}",
+                       current.armed ? 1 : 0, (unsigned long)current.alarm_mask,
+                       (unsigned long)current.ajar_mask, alert_names[current.last_alert],
+                       current.last_channel, outbox_boot_id());
+    return publisher_publish(MQTT_TOPIC_ALERT, payload, len, true);
+}
+
+const char *door_rules_alert_name(door_alert_t alert)
+{
+    if (alert > DOOR_ALERT_DISARMED) {
+        return "unknown";
+    }
+    return alert_names[alert];
+}
@@ -0,0 +1,68 @@
+#ifndef DOOR_RULES_H
+#define DOOR_RULES_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+/**
+ * @brief Alert raised or cleared by the rules, reported as "last" in the alert payload
+ */
+typedef enum {
+    DOOR_ALERT_NONE = 0,
+    DOOR_ALERT_AJAR,            // Open longer than the ajar_s setting
+    DOOR_ALERT_AJAR_CLEARED,    // An ajar door was closed
+    DOOR_ALERT_ALARM,           // Opened while armed
+    DOOR_ALERT_ARMED,
+    DOOR_ALERT_DISARMED,        // Also silences a sounding alarm
+} door_alert_t;
+
+/**
+ * @brief Current rule state
+ */
+typedef struct {
+    bool armed;
+    uint32_t open_mask;         // Debounced door state, as reported by the events
+    uint32_t ajar_mask;         // Channels open longer than the ajar timeout
+    uint32_t alarm_mask;        // Channels opened while armed, latched until disarmed
+    door_alert_t last_alert;
+    uint8_t last_channel;
+} door_rules_state_t;
+
+/**
+ * @brief Load the armed state, subscribe to door events and start the rules task
+ * Requires settings, the Hall sensor, the buzzer and the LED to be initialized.
+ * @return ESP_OK on success, error code on failure
+ */
+esp_err_t door_rules_init(void);
+
+/**
+ * @brief Arm or disarm the forced-entry rule (persisted in NVS)
+ * Only doors opened after arming raise an alarm; disarming silences a sounding alarm.
+ * @param armed true to arm, false to disarm
+ * @return ESP_OK on success, error code on failure
+ */
+esp_err_t door_rules_arm(bool armed);
+
+/**
+ * @brief Get the current rule state
+ * @param state Output state
+ */
+void door_rules_get_state(door_rules_state_t *state);
+
+/**
+ * @brief Publish the rule state to MQTT_TOPIC_ALERT (retained)
+ * May block; call from a task, not from a timer or event callback.
+ * @return ESP_OK on success, ESP_ERR_INVALID_STATE if MQTT is not connected
+ */
+esp_err_t door_rules_publish(void);
+
+/**
+ * @brief Name of an alert, as used in the alert payload
+ * @param alert Alert
+ * @return Alert name
+ */
+const char *door_rules_alert_name(door_alert_t alert);
+
+#endif // DOOR_RULES_H
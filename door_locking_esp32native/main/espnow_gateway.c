@@ -0,0 +1,226 @@
+#include "espnow_gateway.h"
+#include "config.h"
+#include "binlog.h"
+#include "event_codec.h"
+#include "publisher.h"
+#include "rtos_alloc.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_wifi.h"
+#include "esp_now.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include <stdio.h>
+#include <string.h>
+
+static const char *TAG = "ESPNOW_GATEWAY";
+
+#define NODE_REFRESH    0xFF    // Queue item asking to republish every known node
+
+/**
+ * @brief Received frame handed from the WiFi task to the forward task
+ */
+typedef struct {
+    uint8_t node;               // Index in ESPNOW_NODES, or NODE_REFRESH
+    door_event_t event;
+} espnow_frame_t;
+
+static const espnow_node_config_t nodes[] = ESPNOW_NODES;
+#define NODE_COUNT  (sizeof(nodes) / sizeof(nodes[0]))
+
+_Static_assert(NODE_COUNT <= ESPNOW_MAX_NODES, "ESPNOW_NODES has more than ESPNOW_MAX_NODES entries");
+_Static_assert(sizeof(ESPNOW_PMK) - 1 == ESP_NOW_KEY_LEN, "ESPNOW_PMK must be 16 characters");
+_Static_assert(sizeof(ESPNOW_LMK) - 1 == 0 || sizeof(ESPNOW_LMK) - 1 == ESP_NOW_KEY_LEN,
+               "ESPNOW_LMK must be 16 characters, or \"\" for unencrypted frames");
+
+// Written by the forward task only
+static espnow_node_stats_t node_stats[NODE_COUNT];
+static door_event_t last_event[NODE_COUNT];
+static char state_topics[NODE_COUNT][64];
+
+// Written by the WiFi task only
+static uint32_t rejected = 0;
+
+static QueueHandle_t forward_queue = NULL;
+RTOS_QUEUE_STORAGE(espnow, ESPNOW_QUEUE_LEN, sizeof(espnow_frame_t));
+RTOS_TASK_STORAGE(espnow, ESPNOW_TASK_STACK_SIZE);
+
+static int find_node(const uint8_t *mac)
+{
+    for (size_t i = 0; i < NODE_COUNT; i++) {
+        if (memcmp(nodes[i].mac, mac, sizeof(nodes[i].mac)) == 0) {
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief ESP-NOW receive callback (WiFi task context, must not block)
+ */
+static void espnow_recv_callback(const esp_now_recv_info_t *info, const uint8_t *data, int len)
+{
+    int node = find_node(info->src_addr);
+    espnow_frame_t frame;
+    
+    if (node < 0 || !event_decode_compact(data, (size_t)len, &frame.event)) {
+        rejected++;
+        BINLOG(ESPNOW_UNKNOWN, info->src_addr[3], info->src_addr[4], info->src_addr[5], len);
+        return;
+    }
+    
+    // The frame carries no time; events are stamped on arrival like local transitions
+    frame.node = (uint8_t)node;
+    frame.event.timestamp_us = esp_timer_get_time();
+    frame.event.rssi = (int8_t)info->rx_ctrl->rssi;
+    
+    if (xQueueSend(forward_queue, &frame, 0) != pdTRUE) {
+        rejected++;
+    }
+}
+
+static void publish_node_state(size_t node)
+{
+    const door_event_t *event = &last_event[node];
+    esp_err_t ret;
+    
+    // Same payload as a local channel's state topic
+    if (MQTT_STATE_FORMAT == PAYLOAD_FORMAT_BINARY) {
+        uint8_t payload[EVENT_BINARY_SIZE];
+        size_t len = event_encode_binary(event, payload, sizeof(payload));
+        ret = publisher_publish(state_topics[node], (const char *)payload, (int)len, true);
+    } else {
+        ret = publisher_publish(state_topics[node], event_state_text(event->open), 0, true);
+    }
+    
+    // Offline: the state is republished once connected
+    if (ret == ESP_OK) {
+        BINLOG(ESPNOW_FORWARDED, BINLOG_STR(nodes[node].id), BINLOG_STR(event_state_text(event->open)),
+               event->seq, event->rssi);
+    }
+}
+
+// ----------------- Forward task -----------------
+static void espnow_task(void *pvParameters)
+{
+    espnow_frame_t frame;
+    
+    while (1) {
+        xQueueReceive(forward_queue, &frame, portMAX_DELAY);
+        
+        if (frame.node == NODE_REFRESH) {
+            for (size_t i = 0; i < NODE_COUNT; i++) {
+                if (node_stats[i].known) {
+                    publish_node_state(i);
+                }
+            }
+            continue;
+        }
+        
+        espnow_node_stats_t *stats = &node_stats[frame.node];
+        stats->frames++;
+        stats->rssi = frame.event.rssi;
+        stats->last_seen_s = (uint32_t)(frame.event.timestamp_us / 1000000);
+        
+        // A node resends when the link-layer ACK got lost, although the frame arrived
+        if (stats->known && frame.event.boot_id == last_event[frame.node].boot_id &&
+            frame.event.seq == last_event[frame.node].seq) {
+            stats->duplicates++;
+            BINLOG(ESPNOW_DUPLICATE, BINLOG_STR(nodes[frame.node].id), frame.event.seq);
+            continue;
+        }
+        
+        last_event[frame.node] = frame.event;
+        stats->last_seq = frame.event.seq;
+        stats->open = frame.event.open;
+        stats->known = true;
+        
+        publish_node_state(frame.node);
+    }
+}
+
+esp_err_t espnow_gateway_init(void)
+{
+    for (size_t i = 0; i < NODE_COUNT; i++) {
+        snprintf(state_topics[i], sizeof(state_topics[i]), "%s/%s/state", MQTT_TOPIC_PREFIX, nodes[i].id);
+        node_stats[i] = (espnow_node_stats_t){ .id = nodes[i].id };
+    }
+    
+    forward_queue = rtos_queue_create(ESPNOW_QUEUE_LEN, sizeof(espnow_frame_t), RTOS_QUEUE(espnow));
+    if (forward_queue == NULL) {
+        ESP_LOGE(TAG, "Failed to create forward queue");
+        return ESP_FAIL;
+    }
+    
+    esp_err_t ret = rtos_task_create(espnow_task, "espnow", ESPNOW_TASK_STACK_SIZE, NULL,
+                                     ESPNOW_TASK_PRIORITY, RTOS_CORE_NETWORK, RTOS_TASK(espnow), NULL);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to create forward task");
+        return ESP_FAIL;
+    }
+    
+    ret = esp_now_init();
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to initialize ESP-NOW: %s", esp_err_to_name(ret));
+        return ret;
+    }
+    
+    // Encrypted frames are only accepted from registered peers with the same LMK
+    bool encrypt = sizeof(ESPNOW_LMK) - 1 != 0;
+    if (encrypt) {
+        esp_now_set_pmk((const uint8_t *)ESPNOW_PMK);
+        for (size_t i = 0; i < NODE_COUNT; i++) {
+            esp_now_peer_info_t peer = {
+                .channel = 0,   // Current channel
+                .ifidx = WIFI_IF_STA,
+                .encrypt = true,
+            };
+            memcpy(peer.peer_addr, nodes[i].mac, sizeof(peer.peer_addr));
+            memcpy(peer.lmk, ESPNOW_LMK, ESP_NOW_KEY_LEN);
+            ret = esp_now_add_peer(&peer);
+            if (ret != ESP_OK) {
+                ESP_LOGE(TAG, "Failed to add node %s: %s", nodes[i].id, esp_err_to_name(ret));
+            }
+        }
+    } else {
+        ESP_LOGW(TAG, "ESPNOW_LMK is empty, node frames are accepted unencrypted from spoofable MACs");
+    }
+    
+    ret = esp_now_register_recv_cb(espnow_recv_callback);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to register receive callback: %s", esp_err_to_name(ret));
+        return ret;
+    }
+    
+    // Nodes address the gateway by this MAC (ESPNOW_GATEWAY_MAC)
+    uint8_t mac[6] = {0};
+    esp_wifi_get_mac(WIFI_IF_STA, mac);
+    ESP_LOGI(TAG, "Gateway %02x:%02x:%02x:%02x:%02x:%02x for %u nodes (%s)", mac[0], mac[1], mac[2], mac[3],
+             mac[4], mac[5], (unsigned)NODE_COUNT, encrypt ? "encrypted" : "unencrypted");
+    return ESP_OK;
+}
+
+void espnow_gateway_on_connected(void)
+{
+    if (forward_queue == NULL) {
+        return;
+    }
+    
+    espnow_frame_t refresh = { .node = NODE_REFRESH };
+    xQueueSend(forward_queue, &refresh, 0);
+}
+
+esp_err_t espnow_gateway_get_stats(size_t index, espnow_node_stats_t *stats)
+{
+    if (index >= NODE_COUNT) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    
+    *stats = node_stats[index];
+    return ESP_OK;
+}
+
+uint32_t espnow_gateway_get_rejected(void)
+{
+    return rejected;
+}
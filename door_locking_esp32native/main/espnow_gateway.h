@@ -0,0 +1,61 @@
+#ifndef ESPNOW_GATEWAY_H
+#define ESPNOW_GATEWAY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+#define ESPNOW_MAX_NODES    8
+
+/**
+ * @brief ESP-NOW sensor node accepted by the gateway (ESPNOW_NODES in config.h)
+ */
+typedef struct {
+    uint8_t mac[6];         // STA MAC of the node
+    const char *id;         // Topic component: state goes to MQTT_TOPIC_PREFIX "/<id>/state"
+} espnow_node_config_t;
+
+/**
+ * @brief Reception counters and last state of one node
+ */
+typedef struct {
+    const char *id;
+    uint32_t frames;        // Valid frames received
+    uint32_t duplicates;    // Retransmissions of an already forwarded event
+    uint32_t last_seq;
+    uint32_t last_seen_s;   // Gateway uptime at the last frame
+    int8_t rssi;            // dBm of the last frame
+    bool open;
+    bool known;             // A state was received since boot
+} espnow_node_stats_t;
+
+/**
+ * @brief Start receiving door events from the ESPNOW_NODES table and forwarding them to MQTT
+ * Call after wifi_init(); frames are received on the channel of the gateway's AP.
+ * Keeps the radio out of modem sleep, since ESP-NOW frames are only heard while it is awake.
+ * @return ESP_OK on success, error code on failure
+ */
+esp_err_t espnow_gateway_init(void);
+
+/**
+ * @brief Republish the last state of every node (call when connectivity turns CONN_STATE_ONLINE)
+ * Only notifies the forward task, so it is safe to call from event callbacks.
+ */
+void espnow_gateway_on_connected(void);
+
+/**
+ * @brief Get the counters of a node
+ * @param index Node index in ESPNOW_NODES
+ * @param stats Output statistics
+ * @return ESP_OK on success, ESP_ERR_NOT_FOUND past the last node
+ */
+esp_err_t espnow_gateway_get_stats(size_t index, espnow_node_stats_t *stats);
+
+/**
+ * @brief Get the number of frames dropped before forwarding
+ * @return Frames from unknown senders, malformed frames and frames lost to a full queue
+ */
+uint32_t espnow_gateway_get_rejected(void);
+
+#endif // ESPNOW_GATEWAY_H
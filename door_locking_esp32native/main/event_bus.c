@@ -0,0 +1,92 @@
+#include "event_bus.h"
+#include "rtos_alloc.h"
+#include "trace.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include <stdatomic.h>
+
+static const char *TAG = "EVENT_BUS";
+
+typedef struct {
+    const char *name;
+    QueueHandle_t queue;
+    UBaseType_t length;
+    atomic_uint delivered;
+    atomic_uint dropped;
+} subscriber_t;
+
+static subscriber_t subscribers[EVENT_BUS_MAX_SUBSCRIBERS];
+static atomic_size_t subscriber_count = 0;     // Entries below this index are fully initialized
+static portMUX_TYPE subscribe_lock = portMUX_INITIALIZER_UNLOCKED;
+
+QueueHandle_t event_bus_subscribe(const char *name, UBaseType_t length, uint8_t *items, StaticQueue_t *buffer)
+{
+    QueueHandle_t queue = rtos_queue_create(length, sizeof(bus_event_t), items, buffer);
+    if (queue == NULL) {
+        ESP_LOGE(TAG, "Failed to create queue for %s", name);
+        return NULL;
+    }
+    
+    portENTER_CRITICAL(&subscribe_lock);
+    size_t index = atomic_load_explicit(&subscriber_count, memory_order_relaxed);
+    if (index < EVENT_BUS_MAX_SUBSCRIBERS) {
+        subscribers[index].name = name;
+        subscribers[index].queue = queue;
+        subscribers[index].length = length;
+        atomic_init(&subscribers[index].delivered, 0);
+        atomic_init(&subscribers[index].dropped, 0);
+        // Publish the entry only once it is complete; event_bus_post() never takes the lock
+        atomic_store_explicit(&subscriber_count, index + 1, memory_order_release);
+    }
+    portEXIT_CRITICAL(&subscribe_lock);
+    
+    if (index >= EVENT_BUS_MAX_SUBSCRIBERS) {
+        ESP_LOGE(TAG, "Subscriber table full, %s not registered", name);
+        vQueueDelete(queue);
+        return NULL;
+    }
+    
+    ESP_LOGI(TAG, "Subscriber %s (queue of %u)", name, (unsigned)length);
+    return queue;
+}
+
+size_t event_bus_post(const hall_event_t *event)
+{
+    bus_event_t message = {
+        .door = *event,
+        .posted_us = esp_timer_get_time(),
+    };
+    
+    // One non-blocking copy per subscriber: a slow consumer only loses its own events
+    size_t count = atomic_load_explicit(&subscriber_count, memory_order_acquire);
+    size_t delivered = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (xQueueSend(subscribers[i].queue, &message, 0) == pdTRUE) {
+            atomic_fetch_add_explicit(&subscribers[i].delivered, 1, memory_order_relaxed);
+            delivered++;
+        } else {
+            atomic_fetch_add_explicit(&subscribers[i].dropped, 1, memory_order_relaxed);
+            trace_count(TRACE_QUEUE_DROPPED);
+        }
+    }
+    
+    return delivered;
+}
+
+esp_err_t event_bus_get_stats(size_t index, event_bus_stats_t *stats)
+{
+    if (stats == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (index >= atomic_load_explicit(&subscriber_count, memory_order_acquire)) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    
+    const subscriber_t *subscriber = &subscribers[index];
+    stats->name = subscriber->name;
+    stats->delivered = atomic_load_explicit(&subscriber->delivered, memory_order_relaxed);
+    stats->dropped = atomic_load_explicit(&subscriber->dropped, memory_order_relaxed);
+    stats->waiting = uxQueueMessagesWaiting(subscriber->queue);
+    stats->length = subscriber->length;
+    return ESP_OK;
+}
@@ -0,0 +1,60 @@
+#ifndef EVENT_BUS_H
+#define EVENT_BUS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "hall_sensor.h"
+
+#define EVENT_BUS_MAX_SUBSCRIBERS  6
+
+/**
+ * @brief Door transition as delivered to every subscriber
+ */
+typedef struct {
+    hall_event_t door;
+    int64_t posted_us;      // esp_timer_get_time() at event_bus_post(), for TRACE_DETECT_TO_PUBLISH
+} bus_event_t;
+
+/**
+ * @brief Delivery counters of one subscriber
+ */
+typedef struct {
+    const char *name;
+    uint32_t delivered;     // Events queued for the subscriber
+    uint32_t dropped;       // Events lost because its queue was full
+    uint32_t waiting;       // Events currently queued
+    uint32_t length;        // Queue length
+} event_bus_stats_t;
+
+/**
+ * @brief Register a subscriber with its own queue of bus_event_t
+ * Subscribe during initialization, before the Hall task starts posting.
+ * Declare the storage with RTOS_QUEUE_STORAGE(name, length, sizeof(bus_event_t)) and pass RTOS_QUEUE(name).
+ * @param name Subscriber name for diagnostics (must stay valid)
+ * @param length Queue length
+ * @param items Queue item storage, used when RTOS_STATIC_ALLOCATION is set
+ * @param buffer Queue control block storage, used when RTOS_STATIC_ALLOCATION is set
+ * @return Queue to receive from, NULL if the subscriber table is full or the queue could not be created
+ */
+QueueHandle_t event_bus_subscribe(const char *name, UBaseType_t length, uint8_t *items, StaticQueue_t *buffer);
+
+/**
+ * @brief Copy a door transition to every subscriber queue without blocking
+ * Full queues drop the event for that subscriber only.
+ * @param event Debounced transition
+ * @return Number of subscribers that received the event
+ */
+size_t event_bus_post(const hall_event_t *event);
+
+/**
+ * @brief Get delivery counters of a subscriber
+ * @param index Subscriber index, in subscription order
+ * @param stats Output statistics
+ * @return ESP_OK on success, ESP_ERR_NOT_FOUND past the last subscriber
+ */
+esp_err_t event_bus_get_stats(size_t index, event_bus_stats_t *stats);
+
+#endif // EVENT_BUS_H
@@ -0,0 +1,79 @@
+#include "event_codec.h"
+#include <stdio.h>
+
+static void put_le(uint8_t *buf, uint64_t value, size_t bytes)
+{
+    for (size_t i = 0; i < bytes; i++) {
+        buf[i] = (uint8_t)(value >> (8 * i));
+    }
+}
+
+size_t event_encode_binary(const door_event_t *event, uint8_t *buf, size_t len)
+{
+    if (event == NULL || buf == NULL || len < EVENT_BINARY_SIZE) {
+        return 0;
+    }
+    
+    buf[0] = EVENT_BINARY_VERSION;
+    buf[1] = (event->open ? 0x01 : 0x00) | (uint8_t)(event->channel << 1);
+    put_le(&buf[2], event->boot_id, 2);
+    put_le(&buf[4], event->seq, 4);
+    put_le(&buf[8], (uint64_t)event->timestamp_us, 8);
+    buf[16] = event->bounce_count;
+    buf[17] = (uint8_t)event->rssi;
+    
+    return EVENT_BINARY_SIZE;
+}
+
+size_t event_encode_compact(const door_event_t *event, uint8_t *buf, size_t len)
+{
+    if (event == NULL || buf == NULL || len < EVENT_COMPACT_SIZE) {
+        return 0;
+    }
+    
+    buf[0] = EVENT_BINARY_VERSION;
+    buf[1] = (event->open ? 0x01 : 0x00) | (uint8_t)(event->channel << 1);
+    put_le(&buf[2], event->boot_id, 2);
+    put_le(&buf[4], event->seq, 4);
+    
+    return EVENT_COMPACT_SIZE;
+}
+
+bool event_decode_compact(const uint8_t *buf, size_t len, door_event_t *event)
+{
+    if (buf == NULL || event == NULL || len != EVENT_COMPACT_SIZE || buf[0] != EVENT_BINARY_VERSION) {
+        return false;
+    }
+    
+    *event = (door_event_t){
+        .seq = (uint32_t)buf[4] | (uint32_t)buf[5] << 8 | (uint32_t)buf[6] << 16 | (uint32_t)buf[7] << 24,
+        .boot_id = (uint16_t)(buf[2] | buf[3] << 8),
+        .channel = buf[1] >> 1,
+        .open = (buf[1] & 0x01) != 0,
+    };
+    return true;
+}
+
+size_t event_format_text(const door_event_t *event, const char *channel_id, char *buf, size_t len)
+{
+    if (event == NULL || buf == NULL || len == 0) {
+        return 0;
+    }
+    
+    bool has_id = (channel_id != NULL && channel_id[0] != '\0');
+    int written = snprintf(buf, len, "%lu,%u,%lu,%s%s%s\n",
+                           (unsigned long)event->seq, event->boot_id,
+                           (unsigned long)(event->timestamp_us / 1000),
+                           event_state_text(event->open),
+                           has_id ? "," : "", has_id ? channel_id : "");
+    if (written < 0 || (size_t)written >= len) {
+        return 0;
+    }
+    
+    return (size_t)written;
+}
+
+const char *event_state_text(bool open)
+{
+    return open ? "OPEN" : "CLOSED";
+}
@@ -0,0 +1,81 @@
+#ifndef EVENT_CODEC_H
+#define EVENT_CODEC_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// Payload formats, selectable per topic in config.h
+#define PAYLOAD_FORMAT_TEXT     0   // "OPEN"/"CLOSED", or one "seq,boot,uptime_ms,STATE[,id]" line per event
+#define PAYLOAD_FORMAT_BINARY   1   // Fixed-layout records, EVENT_BINARY_SIZE bytes each
+
+#define EVENT_BINARY_VERSION    1
+#define EVENT_BINARY_SIZE       18
+#define EVENT_COMPACT_SIZE      8   // ESP-NOW frame: the first 8 bytes of the binary record
+#define EVENT_TEXT_LINE_MAX     56
+
+/**
+ * @brief Door event as reported over MQTT
+ */
+typedef struct {
+    uint32_t seq;            // Event sequence number within the boot
+    int64_t timestamp_us;    // esp_timer_get_time() of the transition
+    uint16_t boot_id;        // Boot counter; (boot_id, seq) identifies an event
+    uint8_t channel;         // Hall sensor channel index
+    bool open;
+    uint8_t bounce_count;    // Edges rejected by the debouncer since the previous transition
+    int8_t rssi;             // dBm at the time of the event, 0 if unknown
+} door_event_t;
+
+/**
+ * @brief Encode an event as a fixed-layout little-endian record
+ *
+ * Layout: version(1) flags(1, bit0 = OPEN, bits 1-7 = channel) boot_id(2) seq(4)
+ *         timestamp_us(8) bounce_count(1) rssi(1)
+ *
+ * @param event Event to encode
+ * @param buf Output buffer
+ * @param len Size of the output buffer
+ * @return EVENT_BINARY_SIZE, or 0 if the buffer is too small
+ */
+size_t event_encode_binary(const door_event_t *event, uint8_t *buf, size_t len);
+
+/**
+ * @brief Encode the identity and state of an event as an ESP-NOW frame
+ * Same layout as the first EVENT_COMPACT_SIZE bytes of event_encode_binary(); the gateway
+ * stamps the time and RSSI on reception.
+ * @param event Event to encode
+ * @param buf Output buffer
+ * @param len Size of the output buffer
+ * @return EVENT_COMPACT_SIZE, or 0 if the buffer is too small
+ */
+size_t event_encode_compact(const door_event_t *event, uint8_t *buf, size_t len);
+
+/**
+ * @brief Decode an ESP-NOW frame written by event_encode_compact()
+ * Fields not carried by the frame (timestamp, bounce count, RSSI) are zeroed.
+ * @param buf Received frame
+ * @param len Frame length
+ * @param event Output event
+ * @return true if the frame has the expected size and version
+ */
+bool event_decode_compact(const uint8_t *buf, size_t len, door_event_t *event);
+
+/**
+ * @brief Format an event as a "seq,boot,uptime_ms,STATE[,id]\n" text line
+ * @param event Event to format
+ * @param channel_id Channel id appended as the last field, omitted if NULL or empty
+ * @param buf Output buffer
+ * @param len Size of the output buffer
+ * @return Number of characters written (excluding NUL), 0 if the buffer is too small
+ */
+size_t event_format_text(const door_event_t *event, const char *channel_id, char *buf, size_t len);
+
+/**
+ * @brief Get the legacy text payload for a door state
+ * @param open true if the door is open
+ * @return "OPEN" or "CLOSED"
+ */
+const char *event_state_text(bool open);
+
+#endif // EVENT_CODEC_H
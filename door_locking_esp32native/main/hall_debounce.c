@@ -0,0 +1,76 @@
+#include "hall_debounce.h"
+
+void hall_debounce_reset(hall_debounce_t *d, uint16_t debounce_ms, bool raw_open, int64_t now_us)
+{
+    *d = (hall_debounce_t){
+        .window_us = (int64_t)debounce_ms * 1000,
+        .stable_open = true,
+        .raw_open = raw_open,
+        .pending = true,
+        .burst_start_us = now_us,
+        .last_edge_us = now_us,
+        .burst_edges = 0,
+    };
+}
+
+void hall_debounce_set_window(hall_debounce_t *d, uint16_t debounce_ms)
+{
+    d->window_us = (int64_t)debounce_ms * 1000;
+}
+
+void hall_debounce_edge(hall_debounce_t *d, bool raw_open, bool own_edge, int64_t timestamp_us)
+{
+    if (raw_open == d->raw_open && !own_edge) {
+        return;
+    }
+    
+    if (!d->pending) {
+        d->pending = true;
+        d->burst_start_us = timestamp_us;
+        d->burst_edges = 0;
+    }
+    d->burst_edges++;
+    d->last_edge_us = timestamp_us;
+    d->raw_open = raw_open;
+}
+
+bool hall_debounce_due(const hall_debounce_t *d, int64_t now_us)
+{
+    return d->pending && now_us - d->last_edge_us >= d->window_us;
+}
+
+hall_debounce_result_t hall_debounce_settle(hall_debounce_t *d, bool level_open, int64_t now_us,
+                                            hall_debounce_outcome_t *outcome)
+{
+    if (!hall_debounce_due(d, now_us)) {
+        return HALL_DEBOUNCE_IDLE;
+    }
+    
+    // Edges lost upstream (ring overflow) show up as a level that disagrees
+    if (level_open != d->raw_open) {
+        d->raw_open = level_open;
+        d->burst_edges++;
+        d->last_edge_us = now_us;
+        return HALL_DEBOUNCE_RESTARTED;
+    }
+    
+    d->pending = false;
+    outcome->open = level_open;
+    outcome->timestamp_us = d->burst_start_us;
+    outcome->bounces = d->burst_edges > 0 ? d->burst_edges - 1 : 0;
+    outcome->settle_us = (uint32_t)(d->last_edge_us - d->burst_start_us);
+    
+    if (level_open == d->stable_open) {
+        // Bounced back to the reported state; the initial window of an open-at-boot
+        // channel ends here too, with no edges at all
+        return d->burst_edges > 0 ? HALL_DEBOUNCE_GLITCH : HALL_DEBOUNCE_IDLE;
+    }
+    
+    d->stable_open = level_open;
+    return HALL_DEBOUNCE_TRANSITION;
+}
+
+int64_t hall_debounce_deadline(const hall_debounce_t *d)
+{
+    return d->pending ? d->last_edge_us + d->window_us : INT64_MAX;
+}
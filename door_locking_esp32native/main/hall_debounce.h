@@ -0,0 +1,98 @@
+#ifndef HALL_DEBOUNCE_H
+#define HALL_DEBOUNCE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Stable-window debouncer for one Hall channel.
+ * Pure logic on caller-supplied timestamps with no ESP-IDF dependencies, so
+ * recorded edge traces can be replayed through it off-target.
+ */
+
+/**
+ * @brief Debouncer state of one channel
+ */
+typedef struct {
+    int64_t window_us;      // Level must stay unchanged this long
+    bool stable_open;       // Last reported state
+    bool raw_open;          // Level seen in the latest snapshot
+    bool pending;           // Burst in progress, waiting for a stable window
+    int64_t burst_start_us;
+    int64_t last_edge_us;
+    uint32_t burst_edges;
+} hall_debounce_t;
+
+/**
+ * @brief Result of hall_debounce_settle()
+ */
+typedef enum {
+    HALL_DEBOUNCE_IDLE = 0,     // Nothing settled
+    HALL_DEBOUNCE_RESTARTED,    // Confirmation read disagreed, window restarted
+    HALL_DEBOUNCE_GLITCH,       // Burst settled back to the reported state
+    HALL_DEBOUNCE_TRANSITION,   // New stable state
+} hall_debounce_result_t;
+
+/**
+ * @brief Settled burst, filled for HALL_DEBOUNCE_GLITCH and HALL_DEBOUNCE_TRANSITION
+ */
+typedef struct {
+    bool open;
+    int64_t timestamp_us;   // First edge of the burst
+    uint32_t bounces;       // Extra edges in the burst
+    uint32_t settle_us;     // First to last edge of the burst
+} hall_debounce_outcome_t;
+
+/**
+ * @brief Start a channel as open and pending, so a closed door is reported after one window
+ * @param d Debouncer state
+ * @param debounce_ms Stable window
+ * @param raw_open Current level
+ * @param now_us Current time
+ */
+void hall_debounce_reset(hall_debounce_t *d, uint16_t debounce_ms, bool raw_open, int64_t now_us);
+
+/**
+ * @brief Change the stable window; a pending burst is judged against the new window
+ * @param d Debouncer state
+ * @param debounce_ms Stable window
+ */
+void hall_debounce_set_window(hall_debounce_t *d, uint16_t debounce_ms);
+
+/**
+ * @brief Feed one level snapshot
+ * @param d Debouncer state
+ * @param raw_open Level in the snapshot
+ * @param own_edge true if the snapshot was taken by this channel's interrupt
+ *                 (an edge even if the pin already flipped back)
+ * @param timestamp_us Snapshot time
+ */
+void hall_debounce_edge(hall_debounce_t *d, bool raw_open, bool own_edge, int64_t timestamp_us);
+
+/**
+ * @brief Check whether the stable window of a pending burst has elapsed
+ * @param d Debouncer state
+ * @param now_us Current time
+ * @return true if hall_debounce_settle() should be called with a fresh level
+ */
+bool hall_debounce_due(const hall_debounce_t *d, int64_t now_us);
+
+/**
+ * @brief Settle a due burst against a confirmation read of the pin
+ * @param d Debouncer state
+ * @param level_open Level read now
+ * @param now_us Current time
+ * @param outcome Receives the settled burst
+ * @return What happened
+ */
+hall_debounce_result_t hall_debounce_settle(hall_debounce_t *d, bool level_open, int64_t now_us,
+                                            hall_debounce_outcome_t *outcome);
+
+/**
+ * @brief Time at which the pending window ends
+ * @param d Debouncer state
+ * @return Deadline in microseconds, INT64_MAX if no burst is pending
+ */
+int64_t hall_debounce_deadline(const hall_debounce_t *d);
+
+#endif // HALL_DEBOUNCE_H
@@ -1,95 +1,443 @@
 #include "hall_sensor.h"
+#include "hall_debounce.h"
 #include "config.h"
+#include "settings.h"
 #include "esp_log.h"
 #include "driver/gpio.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
-#include "freertos/semphr.h"
+#include "esp_timer.h"
+#include "esp_sleep.h"
+#include "esp_ipc.h"
+#include "rtos_alloc.h"
+#include "soc/soc.h"
+#include "soc/gpio_reg.h"
+#include <stdatomic.h>
 
 static const char *TAG = "HALL_SENSOR";
 
-static bool last_state = true;  // HIGH = no magnet, LOW = magnet detected
-static void (*state_change_callback)(bool state) = NULL;
-static SemaphoreHandle_t hall_mutex = NULL;
+// Edge ring buffer between the ISR (single producer) and the consumer task (single consumer)
+#define HALL_EDGE_RING_SIZE 32  // Must be a power of two
+#define HALL_EDGE_RING_MASK (HALL_EDGE_RING_SIZE - 1)
 
 /**
- * @brief GPIO interrupt handler for Hall sensor
+ * @brief Snapshot of all channels captured by the GPIO interrupt
+ */
+typedef struct {
+    uint32_t open_mask;     // Bit n set if channel n reads "open"
+    uint8_t channel;        // Channel whose interrupt took the snapshot
+    int64_t timestamp_us;   // esp_timer_get_time() at the edge
+} hall_edge_t;
+
+#define HALL_DRAIN_BATCH    8   // Snapshots processed per drain
+
+static volatile uint32_t last_state = 0;  // Bit n set if channel n is open
+static void (*state_change_callback)(uint32_t open_mask) = NULL;
+static bool hall_initialized = false;
+
+// Registered channels; the pin masks let one register read sample all of them
+static const hall_channel_config_t *channels = NULL;
+static size_t channel_count = 0;
+static uint64_t channel_pin_mask = 0;
+
+static hall_edge_t edge_ring[HALL_EDGE_RING_SIZE];
+static atomic_uint ring_head = 0;       // Written by the ISR only
+static atomic_uint ring_tail = 0;       // Written by the consumer only
+static atomic_uint ring_overflows = 0;  // Edges dropped because the ring was full
+static TaskHandle_t consumer_task = NULL;
+
+static hall_debounce_t debounce[HALL_MAX_CHANNELS];  // Consumer task only
+static uint16_t applied_debounce_ms = 0;              // settings debounce_ms the windows were built from
+static hall_channel_stats_t stats[HALL_MAX_CHANNELS];
+static portMUX_TYPE stats_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/**
+ * @brief Stable window of a channel: the runtime setting if set, else the channel table
+ */
+static uint16_t hall_sensor_window_ms(size_t channel)
+{
+    uint16_t override_ms = settings_get()->debounce_ms;
+    return override_ms ? override_ms : channels[channel].debounce_ms;
+}
+
+static void hall_sensor_install_isr_service(void *arg)
+{
+    *(esp_err_t *)arg = gpio_install_isr_service(0);
+}
+
+/**
+ * @brief Level interrupt that fires when the pin leaves the given level
+ * Level triggers double as light-sleep wakeup sources, edge triggers cannot wake the chip.
+ */
+static inline gpio_int_type_t hall_sensor_level_trigger(int level)
+{
+    return level ? GPIO_INTR_LOW_LEVEL : GPIO_INTR_HIGH_LEVEL;
+}
+
+/**
+ * @brief Sample every channel from the GPIO input registers
+ * @return Bitmask, bit n set if channel n reads "open"
+ */
+static uint32_t IRAM_ATTR hall_sensor_sample(void)
+{
+    uint64_t levels = REG_READ(GPIO_IN_REG);
+    if (channel_pin_mask >> 32) {
+        levels |= (uint64_t)REG_READ(GPIO_IN1_REG) << 32;
+    }
+    
+    uint32_t open_mask = 0;
+    for (size_t i = 0; i < channel_count; i++) {
+        if (((levels >> channels[i].pin) & 1) == channels[i].open_level) {
+            open_mask |= 1UL << i;
+        }
+    }
+    return open_mask;
+}
+
+/**
+ * @brief GPIO interrupt handler for a Hall sensor channel
+ * Snapshots all channels, appends the snapshot to the ring buffer and wakes the consumer task
  */
 static void IRAM_ATTR hall_sensor_isr_handler(void* arg)
 {
-    // Simplified ISR - just update the state
-    // The main task will handle the logic
-    last_state = gpio_get_level(HALL_PIN);
+    int64_t now = esp_timer_get_time();
+    uint8_t channel = (uint8_t)(uintptr_t)arg;
+    uint32_t open_mask = hall_sensor_sample();
+    last_state = open_mask;
+    
+    // Re-arm for the opposite level; if the pin already flipped back it fires again at once
+    gpio_num_t pin = channels[channel].pin;
+    int level = ((open_mask >> channel) & 1) ? channels[channel].open_level : !channels[channel].open_level;
+    gpio_wakeup_enable(pin, hall_sensor_level_trigger(level));
+    
+    unsigned int head = atomic_load_explicit(&ring_head, memory_order_relaxed);
+    unsigned int tail = atomic_load_explicit(&ring_tail, memory_order_acquire);
+    
+    if (head - tail >= HALL_EDGE_RING_SIZE) {
+        // Ring full - drop the edge, the consumer re-reads the pin levels anyway
+        atomic_fetch_add_explicit(&ring_overflows, 1, memory_order_relaxed);
+    } else {
+        edge_ring[head & HALL_EDGE_RING_MASK].open_mask = open_mask;
+        edge_ring[head & HALL_EDGE_RING_MASK].channel = channel;
+        edge_ring[head & HALL_EDGE_RING_MASK].timestamp_us = now;
+        atomic_store_explicit(&ring_head, head + 1, memory_order_release);
+    }
+    
+    TaskHandle_t task = consumer_task;
+    if (task != NULL) {
+        BaseType_t higher_priority_task_woken = pdFALSE;
+        vTaskNotifyGiveFromISR(task, &higher_priority_task_woken);
+        if (higher_priority_task_woken) {
+            portYIELD_FROM_ISR();
+        }
+    }
 }
 
-esp_err_t hall_sensor_init(void)
+/**
+ * @brief Copy pending edges out of the ring buffer (consumer side)
+ */
+static size_t hall_sensor_drain(hall_edge_t *edges, size_t max_edges)
 {
-    // Create mutex for thread safety
-    hall_mutex = xSemaphoreCreateMutex();
-    if (hall_mutex == NULL) {
-        ESP_LOGE(TAG, "Failed to create Hall sensor mutex");
-        return ESP_FAIL;
+    unsigned int tail = atomic_load_explicit(&ring_tail, memory_order_relaxed);
+    unsigned int head = atomic_load_explicit(&ring_head, memory_order_acquire);
+    size_t count = 0;
+    
+    while (tail != head && count < max_edges) {
+        edges[count++] = edge_ring[tail & HALL_EDGE_RING_MASK];
+        tail++;
+    }
+    
+    atomic_store_explicit(&ring_tail, tail, memory_order_release);
+    return count;
+}
+
+esp_err_t hall_sensor_init(const hall_channel_config_t *channel_table, size_t count)
+{
+    if (channel_table == NULL || count == 0 || count > HALL_MAX_CHANNELS) {
+        ESP_LOGE(TAG, "Invalid channel table (%u channels)", (unsigned)count);
+        return ESP_ERR_INVALID_ARG;
     }
     
-    // Configure GPIO
+    atomic_store(&ring_head, 0);
+    atomic_store(&ring_tail, 0);
+    atomic_store(&ring_overflows, 0);
+    
+    channels = channel_table;
+    channel_count = count;
+    channel_pin_mask = 0;
+    for (size_t i = 0; i < count; i++) {
+        channel_pin_mask |= 1ULL << channels[i].pin;
+    }
+    
+    // Configure GPIOs; the level triggers are armed once the initial state is known
     gpio_config_t io_conf = {
         .intr_type = GPIO_INTR_DISABLE,
         .mode = GPIO_MODE_INPUT,
-        .pin_bit_mask = (1ULL << HALL_PIN),
+        .pin_bit_mask = channel_pin_mask,
         .pull_down_en = GPIO_PULLDOWN_DISABLE,
         .pull_up_en = GPIO_PULLUP_ENABLE,
     };
     
     esp_err_t ret = gpio_config(&io_conf);
     if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to configure Hall sensor GPIO: %s", esp_err_to_name(ret));
-        vSemaphoreDelete(hall_mutex);
+        ESP_LOGE(TAG, "Failed to configure Hall sensor GPIOs: %s", esp_err_to_name(ret));
+        return ret;
+    }
+    
+    // Install GPIO ISR service (may already be installed by another driver).
+    // The interrupt is allocated on the calling core, so move it to the sensor core if pinned.
+    if (RTOS_CORE_SENSOR != tskNO_AFFINITY && xPortGetCoreID() != RTOS_CORE_SENSOR) {
+        esp_err_t ipc_ret = esp_ipc_call_blocking(RTOS_CORE_SENSOR, hall_sensor_install_isr_service, &ret);
+        if (ipc_ret != ESP_OK) {
+            ret = ipc_ret;
+        }
+    } else {
+        ret = gpio_install_isr_service(0);
+    }
+    if (ret != ESP_OK && ret != ESP_ERR_INVALID_STATE) {
+        ESP_LOGE(TAG, "Failed to install GPIO ISR service: %s", esp_err_to_name(ret));
         return ret;
     }
     
     // Read initial state
-    last_state = gpio_get_level(HALL_PIN);
+    last_state = hall_sensor_sample();
+    
+    // Every channel starts as open and pending, so closed doors are reported after one stable window
+    int64_t now = esp_timer_get_time();
+    applied_debounce_ms = settings_get()->debounce_ms;
+    for (size_t i = 0; i < count; i++) {
+        hall_debounce_reset(&debounce[i], hall_sensor_window_ms(i), (last_state >> i) & 1, now);
+        stats[i] = (hall_channel_stats_t){0};
+    }
+    
+    for (size_t i = 0; i < count; i++) {
+        gpio_num_t pin = channels[i].pin;
+        int level = gpio_get_level(pin);
+        
+        // Toggle-level trigger also wakes the chip from automatic light sleep
+        gpio_wakeup_enable(pin, hall_sensor_level_trigger(level));
+        
+        ret = gpio_isr_handler_add(pin, hall_sensor_isr_handler, (void *)(uintptr_t)i);
+        if (ret != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to add ISR handler for GPIO%d: %s", pin, esp_err_to_name(ret));
+            return ret;
+        }
+        
+        ret = gpio_intr_enable(pin);
+        if (ret != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to enable interrupt on GPIO%d: %s", pin, esp_err_to_name(ret));
+            return ret;
+        }
+        
+        ESP_LOGI(TAG, "Channel %u on GPIO%d (id \"%s\", open level %d, debounce %dms)",
+                 (unsigned)i, pin, channels[i].id, channels[i].open_level, hall_sensor_window_ms(i));
+    }
+    
+    ret = esp_sleep_enable_gpio_wakeup();
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to enable GPIO wakeup: %s", esp_err_to_name(ret));
+    }
     
-    ESP_LOGI(TAG, "Hall sensor initialized on GPIO%d", HALL_PIN);
+    hall_initialized = true;
+    ESP_LOGI(TAG, "Hall sensor initialized, %u channels (toggled level interrupts, light-sleep wakeup)",
+             (unsigned)count);
     
     return ESP_OK;
 }
 
-bool hall_sensor_read(void)
+size_t hall_sensor_get_channel_count(void)
+{
+    return channel_count;
+}
+
+const hall_channel_config_t *hall_sensor_get_channel(size_t channel)
+{
+    if (channel >= channel_count) {
+        return NULL;
+    }
+    
+    return &channels[channel];
+}
+
+uint32_t hall_sensor_read(void)
+{
+    if (!hall_initialized) {
+        return 0;
+    }
+    
+    return hall_sensor_sample();
+}
+
+uint32_t hall_sensor_get_last_state(void)
+{
+    if (!hall_initialized) {
+        return 0;
+    }
+    
+    return last_state;
+}
+
+/**
+ * @brief Feed one snapshot through the per-channel debouncers
+ */
+static void hall_sensor_feed_edge(const hall_edge_t *edge)
+{
+    for (size_t ch = 0; ch < channel_count; ch++) {
+        hall_debounce_edge(&debounce[ch], (edge->open_mask >> ch) & 1, edge->channel == ch, edge->timestamp_us);
+    }
+}
+
+/**
+ * @brief Report channels whose level has been stable long enough
+ * @return Number of transitions written to events
+ */
+static size_t hall_sensor_settle(hall_event_t *events, size_t max_events, int64_t now)
 {
-    if (hall_mutex == NULL) {
-        return false;
+    size_t count = 0;
+    uint32_t levels = 0;
+    bool sampled = false;
+    
+    for (size_t ch = 0; ch < channel_count && count < max_events; ch++) {
+        if (!hall_debounce_due(&debounce[ch], now)) {
+            continue;
+        }
+        
+        // Confirm against the pin in case edges were lost to a ring overflow
+        if (!sampled) {
+            levels = hall_sensor_sample();
+            sampled = true;
+        }
+        
+        hall_debounce_outcome_t outcome;
+        hall_debounce_result_t result = hall_debounce_settle(&debounce[ch], (levels >> ch) & 1, now, &outcome);
+        
+        portENTER_CRITICAL(&stats_lock);
+        if (result == HALL_DEBOUNCE_GLITCH) {
+            stats[ch].glitches++;
+        } else if (result == HALL_DEBOUNCE_TRANSITION) {
+            stats[ch].transitions++;
+            stats[ch].bounces += outcome.bounces;
+            stats[ch].last_settle_us = outcome.settle_us;
+            if (outcome.settle_us > stats[ch].max_settle_us) {
+                stats[ch].max_settle_us = outcome.settle_us;
+            }
+        }
+        portEXIT_CRITICAL(&stats_lock);
+        
+        if (result != HALL_DEBOUNCE_TRANSITION) {
+            continue;
+        }
+        
+        events[count++] = (hall_event_t){
+            .channel = ch,
+            .open = outcome.open,
+            .timestamp_us = outcome.timestamp_us,
+            .bounce_count = outcome.bounces > UINT8_MAX ? UINT8_MAX : outcome.bounces,
+            .settle_us = outcome.settle_us,
+        };
     }
     
-    xSemaphoreTake(hall_mutex, portMAX_DELAY);
-    bool state = gpio_get_level(HALL_PIN);
-    xSemaphoreGive(hall_mutex);
+    return count;
+}
+
+/**
+ * @brief Time until the earliest pending stable window ends
+ * @return Ticks to wait, portMAX_DELAY if no channel is pending
+ */
+static TickType_t hall_sensor_next_deadline(int64_t now)
+{
+    int64_t earliest_us = INT64_MAX;
+    for (size_t ch = 0; ch < channel_count; ch++) {
+        int64_t deadline = hall_debounce_deadline(&debounce[ch]);
+        if (deadline < earliest_us) {
+            earliest_us = deadline;
+        }
+    }
     
-    return state;
+    if (earliest_us == INT64_MAX) {
+        return portMAX_DELAY;
+    }
+    if (earliest_us <= now) {
+        return 0;
+    }
+    return pdMS_TO_TICKS((earliest_us - now + 999) / 1000) + 1;
 }
 
-bool hall_sensor_get_last_state(void)
+size_t hall_sensor_wait_events(hall_event_t *events, size_t max_events, TickType_t timeout)
 {
-    if (hall_mutex == NULL) {
-        return false;
+    if (!hall_initialized || events == NULL || max_events == 0) {
+        return 0;
     }
     
-    xSemaphoreTake(hall_mutex, portMAX_DELAY);
-    bool state = last_state;
-    xSemaphoreGive(hall_mutex);
+    // The calling task becomes the (single) consumer woken by the ISR
+    consumer_task = xTaskGetCurrentTaskHandle();
+    
+    TickType_t start = xTaskGetTickCount();
+    hall_edge_t edges[HALL_DRAIN_BATCH];
+    
+    while (1) {
+        // Pick up a debounce_ms change made at runtime
+        if (settings_get()->debounce_ms != applied_debounce_ms) {
+            applied_debounce_ms = settings_get()->debounce_ms;
+            for (size_t ch = 0; ch < channel_count; ch++) {
+                hall_debounce_set_window(&debounce[ch], hall_sensor_window_ms(ch));
+            }
+        }
+        
+        size_t drained;
+        while ((drained = hall_sensor_drain(edges, HALL_DRAIN_BATCH)) > 0) {
+            for (size_t i = 0; i < drained; i++) {
+                hall_sensor_feed_edge(&edges[i]);
+            }
+        }
+        
+        int64_t now = esp_timer_get_time();
+        size_t count = hall_sensor_settle(events, max_events, now);
+        if (count > 0) {
+            return count;
+        }
+        
+        // Sleep until the next edge or the end of the earliest stable window
+        TickType_t wait = hall_sensor_next_deadline(now);
+        if (timeout != portMAX_DELAY) {
+            TickType_t elapsed = xTaskGetTickCount() - start;
+            if (elapsed >= timeout) {
+                return 0;
+            }
+            if (timeout - elapsed < wait) {
+                wait = timeout - elapsed;
+            }
+        }
+        
+        // A stale notification for already drained edges just loops once more
+        ulTaskNotifyTake(pdTRUE, wait);
+    }
+}
+
+esp_err_t hall_sensor_get_stats(size_t channel, hall_channel_stats_t *out)
+{
+    if (channel >= channel_count || out == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
     
-    return state;
+    portENTER_CRITICAL(&stats_lock);
+    *out = stats[channel];
+    portEXIT_CRITICAL(&stats_lock);
+    return ESP_OK;
 }
 
-esp_err_t hall_sensor_set_callback(void (*callback)(bool state))
+uint32_t hall_sensor_get_overflow_count(void)
 {
-    if (hall_mutex == NULL) {
+    return atomic_load_explicit(&ring_overflows, memory_order_relaxed);
+}
+
+esp_err_t hall_sensor_set_callback(void (*callback)(uint32_t open_mask))
+{
+    if (!hall_initialized) {
         return ESP_FAIL;
     }
     
-    xSemaphoreTake(hall_mutex, portMAX_DELAY);
     state_change_callback = callback;
-    xSemaphoreGive(hall_mutex);
     
     ESP_LOGI(TAG, "Hall sensor callback registered");
     return ESP_OK;
@@ -97,42 +445,48 @@ esp_err_t hall_sensor_set_callback(void (*callback)(bool state))
 
 esp_err_t hall_sensor_re_enable_interrupt(void)
 {
-    if (hall_mutex == NULL) {
+    if (!hall_initialized) {
         return ESP_FAIL;
     }
     
-    xSemaphoreTake(hall_mutex, portMAX_DELAY);
-    
-    // Re-enable interrupt after debounce
-    gpio_intr_enable(HALL_PIN);
-    
-    xSemaphoreGive(hall_mutex);
-    
-    return ESP_OK;
+    // Re-enable interrupts after debounce
+    esp_err_t ret = ESP_OK;
+    for (size_t i = 0; i < channel_count; i++) {
+        esp_err_t err = gpio_intr_enable(channels[i].pin);
+        if (err != ESP_OK) {
+            ret = err;
+        }
+    }
+    return ret;
 }
 
 esp_err_t hall_sensor_deinit(void)
 {
-    // Remove ISR handler
-    if (gpio_isr_handler_remove(HALL_PIN) != ESP_OK) {
-        ESP_LOGW(TAG, "Failed to remove ISR handler");
+    for (size_t i = 0; i < channel_count; i++) {
+        gpio_num_t pin = channels[i].pin;
+        
+        // Remove ISR handler
+        if (gpio_isr_handler_remove(pin) != ESP_OK) {
+            ESP_LOGW(TAG, "Failed to remove ISR handler for GPIO%d", pin);
+        }
+        
+        gpio_wakeup_disable(pin);
+        
+        // Reset GPIO to default state
+        gpio_reset_pin(pin);
     }
     
     // Uninstall GPIO interrupt service
     gpio_uninstall_isr_service();
     
-    // Reset GPIO to default state
-    gpio_reset_pin(HALL_PIN);
-    
-    // Clean up mutex
-    if (hall_mutex) {
-        vSemaphoreDelete(hall_mutex);
-        hall_mutex = NULL;
-    }
+    hall_initialized = false;
+    consumer_task = NULL;
+    channel_count = 0;
+    channel_pin_mask = 0;
     
     // Clear callback
     state_change_callback = NULL;
     
     ESP_LOGI(TAG, "Hall sensor deinitialized");
     return ESP_OK;
-}
+}
\ No newline at end of file
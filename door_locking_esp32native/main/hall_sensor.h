@@ -1,36 +1,115 @@
 #ifndef HALL_SENSOR_H
 #define HALL_SENSOR_H
 
+#include <stdint.h>
+#include <stddef.h>
 #include "esp_err.h"
 #include "driver/gpio.h"
+#include "freertos/FreeRTOS.h"
+
+#define HALL_MAX_CHANNELS   8
+
+/**
+ * @brief Hall sensor channel (one door or window)
+ */
+typedef struct {
+    gpio_num_t pin;
+    uint8_t open_level;     // GPIO level meaning "open" (1 for an A3144 with pull-up: no magnet)
+    uint16_t debounce_ms;   // Level must stay unchanged this long before a transition is reported
+    const char *id;         // Topic component, "" for the legacy single-sensor topic
+} hall_channel_config_t;
+
+/**
+ * @brief Debounced channel transition
+ */
+typedef struct {
+    uint8_t channel;
+    bool open;
+    int64_t timestamp_us;   // ISR timestamp of the first edge of the burst
+    uint8_t bounce_count;   // Extra edges in the burst before the level settled
+    uint32_t settle_us;     // First to last edge of the burst
+} hall_event_t;
 
 /**
- * @brief Initialize Hall sensor
+ * @brief Debouncer statistics of one channel
+ */
+typedef struct {
+    uint32_t transitions;   // Reported transitions
+    uint32_t bounces;       // Extra edges inside reported bursts
+    uint32_t glitches;      // Bursts that settled back to the previous state
+    uint32_t last_settle_us;
+    uint32_t max_settle_us;
+} hall_channel_stats_t;
+
+/**
+ * @brief Initialize Hall sensor channels
+ * @param channels Channel table (must stay valid), at most HALL_MAX_CHANNELS entries
+ * @param count Number of channels
  * @return ESP_OK on success, error code on failure
  */
-esp_err_t hall_sensor_init(void);
+esp_err_t hall_sensor_init(const hall_channel_config_t *channels, size_t count);
+
+/**
+ * @brief Get number of registered channels
+ * @return Channel count
+ */
+size_t hall_sensor_get_channel_count(void);
+
+/**
+ * @brief Get the configuration of a channel
+ * @param channel Channel index
+ * @return Channel configuration, NULL if the index is out of range
+ */
+const hall_channel_config_t *hall_sensor_get_channel(size_t channel);
+
+/**
+ * @brief Read all channels with a single GPIO input register read
+ * @return Bitmask, bit n set if channel n reads "open"
+ */
+uint32_t hall_sensor_read(void);
+
+/**
+ * @brief Get the channel states captured by the last interrupt
+ * @return Bitmask, bit n set if channel n was "open"
+ */
+uint32_t hall_sensor_get_last_state(void);
+
+/**
+ * @brief Block until debounced transitions are available
+ * The calling task becomes the single consumer of the ISR edge ring buffer and runs
+ * the debouncer: a channel's new level is reported once it was stable for the channel's
+ * debounce_ms, measured from the ISR timestamp of its last edge. Channels closed at boot
+ * are reported as transitions after their first stable window.
+ * @param events Buffer receiving the transitions, in settle order
+ * @param max_events Capacity of the buffer
+ * @param timeout Maximum time to wait in ticks (portMAX_DELAY to wait forever)
+ * @return Number of transitions copied (0 on timeout)
+ */
+size_t hall_sensor_wait_events(hall_event_t *events, size_t max_events, TickType_t timeout);
 
 /**
- * @brief Read Hall sensor state
- * @return true if magnet detected (LOW), false if no magnet (HIGH)
+ * @brief Get debouncer statistics of a channel
+ * @param channel Channel index
+ * @param stats Receives the statistics
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG if the channel does not exist
  */
-bool hall_sensor_read(void);
+esp_err_t hall_sensor_get_stats(size_t channel, hall_channel_stats_t *stats);
 
 /**
- * @brief Get last Hall sensor state
- * @return Last state (true = magnet detected, false = no magnet)
+ * @brief Get number of edges dropped because the ring buffer was full
+ * @return Overflow count since initialization
  */
-bool hall_sensor_get_last_state(void);
+uint32_t hall_sensor_get_overflow_count(void);
 
 /**
  * @brief Set Hall sensor callback for state changes
  * @param callback Function to call when state changes
  * @return ESP_OK on success, error code on failure
  */
-esp_err_t hall_sensor_set_callback(void (*callback)(bool state));
+esp_err_t hall_sensor_set_callback(void (*callback)(uint32_t open_mask));
 
 /**
- * @brief Re-enable interrupt after debounce
+ * @brief Re-enable interrupts of all channels after debounce
  * @return ESP_OK on success, error code on failure
  */
 esp_err_t hall_sensor_re_enable_interrupt(void);
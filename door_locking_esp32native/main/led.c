@@ -0,0 +1,205 @@
+#include "led.h"
+#include "config.h"
+#include "esp_log.h"
+#include "driver/gpio.h"
+#include "freertos/FreeRTOS.h"
+#include "esp_timer.h"
+#include <stdbool.h>
+
+static const char *TAG = "LED";
+
+#define PATTERN_STEPS(...) \
+    .steps = (const uint16_t[]){ __VA_ARGS__ }, \
+    .step_count = sizeof((const uint16_t[]){ __VA_ARGS__ }) / sizeof(uint16_t)
+
+/**
+ * @brief Pattern: alternating on/off durations in ms starting with "on", repeated forever
+ * Patterns without steps hold a steady level and need no timer.
+ */
+typedef struct {
+    const char *name;
+    const uint16_t *steps;
+    uint8_t step_count;
+    bool level;              // Steady level when step_count is 0
+} led_pattern_t;
+
+typedef enum {
+    LED_PATTERN_OFF = 0,
+    LED_PATTERN_ALARM,
+    LED_PATTERN_WIFI_CONNECTING,
+    LED_PATTERN_WIFI_DOWN,
+    LED_PATTERN_MQTT_DOWN,
+    LED_PATTERN_DOOR_OPEN,
+    LED_PATTERN_ONLINE,
+    LED_PATTERN_COUNT
+} led_pattern_id_t;
+
+// Indexed by led_pattern_id_t; lives in flash
+static const led_pattern_t patterns[LED_PATTERN_COUNT] = {
+    [LED_PATTERN_OFF]             = { "off",             NULL, 0, false },
+    [LED_PATTERN_ALARM]           = { "alarm",           PATTERN_STEPS(100, 100),             false },
+    [LED_PATTERN_WIFI_CONNECTING] = { "wifi-connecting", PATTERN_STEPS(250, 250),             false },
+    [LED_PATTERN_WIFI_DOWN]       = { "wifi-down",       PATTERN_STEPS(50, 1950),             false },
+    [LED_PATTERN_MQTT_DOWN]       = { "mqtt-down",       PATTERN_STEPS(100, 200, 100, 1600),  false },
+    [LED_PATTERN_DOOR_OPEN]       = { "door-open",       PATTERN_STEPS(2900, 100),            false },
+    [LED_PATTERN_ONLINE]          = { "online",          NULL, 0, true },
+};
+
+// Engine state
+static uint32_t status_bits = 0;
+static led_pattern_id_t current_pattern = LED_PATTERN_OFF;
+static uint8_t play_step = 0;       // Index of the phase currently shown
+
+// One-shot timer fired at every on/off phase boundary; steady patterns leave it stopped
+static esp_timer_handle_t led_timer = NULL;
+static portMUX_TYPE led_lock = portMUX_INITIALIZER_UNLOCKED;
+// Expiries already dispatched to the esp_timer task when their pattern was replaced
+static uint8_t stale_expiries = 0;
+
+/**
+ * @brief Map the combined status to a pattern, most urgent first
+ */
+static led_pattern_id_t select_pattern(uint32_t bits)
+{
+    if (bits & LED_STATUS_ALARM) {
+        return LED_PATTERN_ALARM;
+    }
+    if (!(bits & LED_STATUS_WIFI_UP)) {
+        return (bits & LED_STATUS_CONNECTING) ? LED_PATTERN_WIFI_CONNECTING : LED_PATTERN_WIFI_DOWN;
+    }
+    if (!(bits & LED_STATUS_MQTT_UP)) {
+        return LED_PATTERN_MQTT_DOWN;
+    }
+    return (bits & LED_STATUS_DOOR_OPEN) ? LED_PATTERN_DOOR_OPEN : LED_PATTERN_ONLINE;
+}
+
+/**
+ * @brief Show a pattern from its first phase (called with led_lock held)
+ */
+static void led_show(led_pattern_id_t id)
+{
+    const led_pattern_t *pattern = &patterns[id];
+    
+    // A blinking pattern always has its timer armed or its callback waiting for led_lock,
+    // which esp_timer_stop() cannot withdraw; that callback must not advance the new pattern
+    if (esp_timer_stop(led_timer) != ESP_OK && patterns[current_pattern].step_count > 0) {
+        stale_expiries++;
+    }
+    current_pattern = id;
+    play_step = 0;
+    
+    if (pattern->step_count == 0) {
+        gpio_set_level(LED_PIN, pattern->level);
+        return;
+    }
+    gpio_set_level(LED_PIN, 1);
+    esp_timer_start_once(led_timer, (uint64_t)pattern->steps[0] * 1000);
+}
+
+/**
+ * @brief Advance the pattern by one phase (esp_timer task context)
+ */
+static void led_timer_callback(void *arg)
+{
+    portENTER_CRITICAL(&led_lock);
+    const led_pattern_t *pattern = &patterns[current_pattern];
+    if (stale_expiries > 0) {
+        stale_expiries--;
+    } else if (pattern->step_count > 0) {
+        play_step = (play_step + 1) % pattern->step_count;
+        
+        // Even steps are lit, odd steps are dark
+        gpio_set_level(LED_PIN, (play_step % 2) == 0);
+        esp_timer_start_once(led_timer, (uint64_t)pattern->steps[play_step] * 1000);
+    }
+    portEXIT_CRITICAL(&led_lock);
+}
+
+esp_err_t led_init(void)
+{
+    const esp_timer_create_args_t timer_args = {
+        .callback = led_timer_callback,
+        .arg = NULL,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "led",
+    };
+    
+    esp_err_t ret = esp_timer_create(&timer_args, &led_timer);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to create LED timer: %s", esp_err_to_name(ret));
+        return ret;
+    }
+    
+    gpio_config_t io_conf = {
+        .intr_type = GPIO_INTR_DISABLE,
+        .mode = GPIO_MODE_OUTPUT,
+        .pin_bit_mask = (1ULL << LED_PIN),
+        .pull_down_en = GPIO_PULLDOWN_DISABLE,
+        .pull_up_en = GPIO_PULLUP_DISABLE,
+    };
+    
+    ret = gpio_config(&io_conf);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to configure LED GPIO: %s", esp_err_to_name(ret));
+        esp_timer_delete(led_timer);
+        led_timer = NULL;
+        return ret;
+    }
+    gpio_sleep_sel_dis(LED_PIN);  // Keep driving the LED during automatic light sleep
+    
+    // Nothing is connected yet
+    portENTER_CRITICAL(&led_lock);
+    led_show(select_pattern(status_bits));
+    portEXIT_CRITICAL(&led_lock);
+    
+    ESP_LOGI(TAG, "LED initialized on GPIO%d", LED_PIN);
+    return ESP_OK;
+}
+
+void led_update(uint32_t mask, uint32_t bits)
+{
+    if (led_timer == NULL) {
+        return;
+    }
+    
+    portENTER_CRITICAL(&led_lock);
+    status_bits = (status_bits & ~mask) | (bits & mask);
+    led_pattern_id_t id = select_pattern(status_bits);
+    bool changed = id != current_pattern;
+    if (changed) {
+        led_show(id);
+    }
+    portEXIT_CRITICAL(&led_lock);
+    
+    if (changed) {
+        ESP_LOGD(TAG, "Pattern %s", patterns[id].name);
+    }
+}
+
+uint32_t led_get_status(void)
+{
+    return status_bits;
+}
+
+const char *led_get_pattern_name(void)
+{
+    return patterns[current_pattern].name;
+}
+
+esp_err_t led_deinit(void)
+{
+    if (led_timer == NULL) {
+        return ESP_FAIL;
+    }
+    
+    portENTER_CRITICAL(&led_lock);
+    led_show(LED_PATTERN_OFF);
+    portEXIT_CRITICAL(&led_lock);
+    
+    gpio_reset_pin(LED_PIN);
+    esp_timer_delete(led_timer);
+    led_timer = NULL;
+    
+    ESP_LOGI(TAG, "LED deinitialized");
+    return ESP_OK;
+}
@@ -0,0 +1,52 @@
+#ifndef LED_H
+#define LED_H
+
+#include <stdint.h>
+#include "esp_err.h"
+
+/**
+ * @brief Status inputs; the displayed pattern is derived from their combination
+ */
+typedef enum {
+    LED_STATUS_WIFI_UP    = 1 << 0,  // IP obtained
+    LED_STATUS_MQTT_UP    = 1 << 1,  // Broker connected
+    LED_STATUS_CONNECTING = 1 << 2,  // A Wi-Fi or MQTT attempt is in progress
+    LED_STATUS_DOOR_OPEN  = 1 << 3,  // At least one channel is open
+    LED_STATUS_ALARM      = 1 << 4,  // An alarm is sounding
+} led_status_bit_t;
+
+#define LED_STATUS_LINK_MASK  (LED_STATUS_WIFI_UP | LED_STATUS_MQTT_UP | LED_STATUS_CONNECTING)
+
+/**
+ * @brief Initialize the LED GPIO and pattern timer
+ * @return ESP_OK on success, error code on failure
+ */
+esp_err_t led_init(void);
+
+/**
+ * @brief Replace the status bits selected by mask and update the display
+ * The pattern restarts only if the combined status maps to a different one.
+ * @param mask Status bits to change
+ * @param bits New values for those bits
+ */
+void led_update(uint32_t mask, uint32_t bits);
+
+/**
+ * @brief Get the current status bitmask
+ * @return Combination of led_status_bit_t
+ */
+uint32_t led_get_status(void);
+
+/**
+ * @brief Name of the pattern currently displayed, for diagnostics
+ * @return Pattern name
+ */
+const char *led_get_pattern_name(void);
+
+/**
+ * @brief Turn the LED off and release the timer
+ * @return ESP_OK on success, error code on failure
+ */
+esp_err_t led_deinit(void);
+
+#endif // LED_H
@@ -4,10 +4,10 @@
  * 
  * Features:
  * - Hall sensor state monitoring
- * - WiFi connection with auto-reconnect
+ * - WiFi and MQTT reconnect with jittered exponential backoff
  * - MQTT communication for status reporting
  * - Non-blocking buzzer control
- * - LED status indication
+ * - LED status patterns for connectivity, door and alarm state
  */
 
 #include <stdio.h>
@@ -28,13 +28,44 @@
 #include "wifi_manager.h"
 #include "hall_sensor.h"
 #include "buzzer.h"
+#include "outbox.h"
+#include "publisher.h"
+#include "power_policy.h"
+#include "command.h"
+#include "telemetry.h"
+#include "trace.h"
+#include "console.h"
+#include "settings.h"
+#include "rtos_alloc.h"
+#include "mqtt_config.h"
+#include "connectivity.h"
+#include "event_bus.h"
+#include "led.h"
+#include "door_rules.h"
+#include "binlog.h"
+#include "ota.h"
+#include "boot_profile.h"
+#include "espnow_gateway.h"
 
 static const char *TAG = "DOOR_LOCK";
 
+#define HALL_EVENT_BATCH_SIZE 8  // Debounced transitions handled per wakeup
+#define CHIME_QUEUE_LEN       4  // A chime only reflects the latest transitions
+#define DOOR_LOG_QUEUE_LEN    16
+
 // Global state variables
-static bool last_hall_state = true;  // HIGH = no magnet, LOW = magnet detected
 static esp_mqtt_client_handle_t mqtt_client = NULL;
-static bool mqtt_connected = false;
+
+// Hall sensor channels (doors and windows) from config.h
+static const hall_channel_config_t hall_channels[] = HALL_CHANNELS;
+
+RTOS_TASK_STORAGE(hall_task, HALL_TASK_STACK_SIZE);
+RTOS_TASK_STORAGE(chime_task, BUZZER_TASK_STACK_SIZE);
+RTOS_TASK_STORAGE(door_log_task, DOOR_LOG_TASK_STACK_SIZE);
+RTOS_QUEUE_STORAGE(chime, CHIME_QUEUE_LEN, sizeof(bus_event_t));
+RTOS_QUEUE_STORAGE(door_log, DOOR_LOG_QUEUE_LEN, sizeof(bus_event_t));
+static QueueHandle_t chime_queue = NULL;
+static QueueHandle_t door_log_queue = NULL;
 
 // ----------------- MQTT callback -----------------
 static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_t event_id, void *event_data)
@@ -43,42 +74,39 @@ static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_
     
     switch ((esp_mqtt_event_id_t)event_id) {
         case MQTT_EVENT_CONNECTED:
-            ESP_LOGI(TAG, "Connected to MQTT broker");
-            mqtt_connected = true;
+            BINLOG(MQTT_CONNECTED, BINLOG_STR(event->session_present ? " (session resumed)" : ""));
             
-            // Subscribe to command topic
-            esp_mqtt_client_subscribe(mqtt_client, MQTT_TOPIC_CMD, 0);
-            ESP_LOGI(TAG, "Subscribed to topic: %s", MQTT_TOPIC_CMD);
+            // A resumed persistent session still holds the command subscription
+            if (!event->session_present) {
+                esp_mqtt_client_subscribe(mqtt_client, MQTT_TOPIC_CMD, 0);
+                BINLOG(MQTT_SUBSCRIBE, BINLOG_STR(MQTT_TOPIC_CMD));
+            }
             
-            // Turn on LED to indicate MQTT connection
-            gpio_set_level(LED_PIN, 1);
+            connectivity_on_mqtt_connected();
             break;
             
         case MQTT_EVENT_DISCONNECTED:
-            ESP_LOGW(TAG, "Disconnected from MQTT broker");
-            mqtt_connected = false;
-            gpio_set_level(LED_PIN, 0);
+            BINLOG(MQTT_DISCONNECTED);
+            connectivity_on_mqtt_disconnected();
             break;
             
         case MQTT_EVENT_DATA:
-            ESP_LOGI(TAG, "--- Get MQTT Message - Topic: %.*s, Data: %.*s", 
-                     event->topic_len, event->topic, 
-                     event->data_len, event->data);
+            // The payload is not kept; the command worker logs the command it parsed
+            BINLOG(MQTT_DATA, event->topic_len, event->data_len);
             
-            // Handle BEEP command
-            if (strncmp(event->data, "BEEP", event->data_len) == 0) {
-                ESP_LOGI(TAG, "Command: BEEP");
-                buzzer_start_beep(5, 300);
-            }
-            // Handle STOP command
-            else if (strncmp(event->data, "STOP", event->data_len) == 0) {
-                ESP_LOGI(TAG, "Command: STOP");
-                buzzer_stop_beep();
-            }
+            // Follow-up commands usually arrive shortly after the first one
+            power_policy_notify(POWER_ACTIVITY_COMMAND);
+            
+            // Parsed and executed by the command worker task, never in the MQTT task
+            command_submit(event->data, event->data_len);
+            break;
+            
+        case MQTT_EVENT_PUBLISHED:
+            publisher_on_published(event->msg_id);
             break;
             
         case MQTT_EVENT_SUBSCRIBED:
-            ESP_LOGI(TAG, "MQTT_EVENT_SUBSCRIBED, msg_id=%d", event->msg_id);
+            BINLOG(MQTT_SUBSCRIBED, event->msg_id);
             break;
             
         case MQTT_EVENT_ERROR:
@@ -93,32 +121,34 @@ static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_
 
 static esp_err_t mqtt_init(void)
 {
-    char mqtt_uri[64];
-    snprintf(mqtt_uri, sizeof(mqtt_uri), "mqtt://%s:%d", MQTT_SERVER, MQTT_PORT);
-    
-    // The Keepalive is set to 60 seconds by default
+    // Broker, TLS, credentials and session options are shared with the deep-sleep build
     esp_mqtt_client_config_t mqtt_cfg = {
-        .broker.address.uri = mqtt_uri,
-        .credentials.username = MQTT_USERNAME,
-        .credentials.authentication.password = MQTT_PASSWORD,
-        .session.keepalive = 60,
+        .task.priority = MQTT_TASK_PRIORITY,  // Core is chosen in sdkconfig (CONFIG_MQTT_USE_CORE_0)
+        // The connectivity controller forces earlier, backed-off reconnects; this is only the safety net
+        .network.reconnect_timeout_ms = CONN_BACKOFF_MAX_MS,
     };
+    esp_err_t ret = mqtt_config_build(&mqtt_cfg);
+    if (ret != ESP_OK) {
+        return ret;
+    }
     
     mqtt_client = esp_mqtt_client_init(&mqtt_cfg);
     if (mqtt_client == NULL) {
         ESP_LOGE(TAG, "Failed to initialize MQTT client");
         return ESP_FAIL;
     }
+    publisher_set_client(mqtt_client);
     
     // Register event handler
     esp_mqtt_client_register_event(mqtt_client, ESP_EVENT_ANY_ID, mqtt_event_handler, NULL);
     
     // Start MQTT client
-    esp_err_t ret = esp_mqtt_client_start(mqtt_client);
+    ret = esp_mqtt_client_start(mqtt_client);
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "Failed to start MQTT client: %s", esp_err_to_name(ret));
         return ret;
     }
+    connectivity_set_mqtt_client(mqtt_client);
     
     ESP_LOGI(TAG, "MQTT client initialized and started");
     return ESP_OK;
@@ -127,53 +157,142 @@ static esp_err_t mqtt_init(void)
 // ----------------- Hall sensor task -----------------
 static void hall_task(void *pvParameters)
 {
-    bool current_state;
-    static uint32_t last_interrupt_time = 0;
+    uint32_t reported_overflows = 0;
+    hall_event_t events[HALL_EVENT_BATCH_SIZE];
     
     while (1) {
-        current_state = hall_sensor_read();
+        // Sleep until the debouncer in hall_sensor.c settles one or more channels
+        size_t count = hall_sensor_wait_events(events, HALL_EVENT_BATCH_SIZE, portMAX_DELAY);
         
-        if (current_state != last_hall_state) {
-            uint32_t current_time = esp_timer_get_time() / 1000;
-            
-            // Debounce check
-            if (current_time - last_interrupt_time > HALL_DEBOUNCE_MS) {
-                last_hall_state = current_state;
-                last_interrupt_time = current_time;
-                
-                if (current_state == 0) {
-                    // LOW = Magnet detected - Door CLOSED (Locked)
-                    ESP_LOGI(TAG, "Door CLOSED");
-                    
-                    // Publish MQTT message
-                    if (mqtt_connected && mqtt_client) {
-                        esp_mqtt_client_publish(mqtt_client, MQTT_TOPIC_STATE, "CLOSED", 6, 1, 0);
-                        ESP_LOGI(TAG, "Published: CLOSED");
-                    }
-                    
-                    // Beep to indicate door closed
-                    buzzer_start_beep(BEEP_DEFAULT_TIMES, BEEP_DEFAULT_DURATION);
-                    
-                } else {
-                    // HIGH = No magnet - Door OPEN (Unlocked)
-                    ESP_LOGI(TAG, "Door OPEN");
-                    
-                    // Publish MQTT message
-                    if (mqtt_connected && mqtt_client) {
-                        esp_mqtt_client_publish(mqtt_client, MQTT_TOPIC_STATE, "OPEN", 4, 1, 0);
-                        ESP_LOGI(TAG, "Published: OPEN");
-                    }
-                    
-                    // Beep to indicate door opened
-                    buzzer_start_beep(BEEP_DEFAULT_TIMES, BEEP_DEFAULT_DURATION);
-                }
-            }
+        uint32_t overflows = hall_sensor_get_overflow_count();
+        if (overflows != reported_overflows) {
+            BINLOG(EDGE_OVERFLOW, overflows);
+            reported_overflows = overflows;
+        }
+        
+        // Side effects run in the subscribers; posting never blocks the sensor path
+        for (size_t i = 0; i < count; i++) {
+            trace_record(TRACE_EDGE_TO_DETECT, esp_timer_get_time() - events[i].timestamp_us);
+            event_bus_post(&events[i]);
+        }
+    }
+}
+
+// ----------------- Door event subscribers -----------------
+static void chime_task(void *pvParameters)
+{
+    bus_event_t event;
+    
+    while (1) {
+        xQueueReceive(chime_queue, &event, portMAX_DELAY);
+        
+        // Beep to indicate the door state change; refused while the alarm or ajar reminder sounds
+        if (settings_get()->beep_times > 0) {
+            buzzer_start_beep(settings_get()->beep_times, settings_get()->beep_duration_ms);
         }
+    }
+}
+
+static void door_log_task(void *pvParameters)
+{
+    bus_event_t event;
+    // Debounced state; every channel starts as open until its first stable window reports it closed
+    uint32_t open_mask = (1u << hall_sensor_get_channel_count()) - 1;
+    
+    while (1) {
+        xQueueReceive(door_log_queue, &event, portMAX_DELAY);
+        
+        BINLOG(DOOR_EVENT, event.door.channel, BINLOG_STR(event.door.open ? "OPEN" : "CLOSED"),
+               event.door.bounce_count, event.door.settle_us);
         
-        vTaskDelay(pdMS_TO_TICKS(10));
+        telemetry_count(TELEMETRY_DOOR_EVENTS);
+        telemetry_set_door_state(event.door.channel, event.door.open);
+        
+        if (event.door.open) {
+            open_mask |= 1u << event.door.channel;
+        } else {
+            open_mask &= ~(1u << event.door.channel);
+        }
+        led_update(LED_STATUS_DOOR_OPEN, open_mask ? LED_STATUS_DOOR_OPEN : 0);
+    }
+}
+
+// ----------------- Network bring-up -----------------
+static void on_connectivity_changed(conn_state_t previous, conn_state_t state)
+{
+    // The publish stage follows the controller, which also notices a vanished AP before MQTT does
+    if (state == CONN_STATE_ONLINE) {
+        // Confirms a connection made on the cached IP lease
+        wifi_on_mqtt_connected();
+        publisher_on_connected();
+        // Alerts raised while offline were only local; refresh the retained alert state
+        command_submit("ALERTS", 6);
+        // Reaching the broker is what confirms a freshly updated image
+        ota_on_online();
+        if (ESPNOW_GATEWAY_ENABLE) {
+            espnow_gateway_on_connected();
+        }
+        if (BOOT_PROFILE_ENABLE) {
+            boot_profile_mark(BOOT_PHASE_MQTT_CONNECTED);
+            command_submit("PROFILE", 7);
+        }
+    } else if (previous == CONN_STATE_ONLINE) {
+        publisher_on_disconnected();
+    }
+    
+    uint32_t link = 0;
+    if (state >= CONN_STATE_MQTT_DOWN) {
+        link |= LED_STATUS_WIFI_UP;
+        boot_profile_mark(BOOT_PHASE_WIFI_CONNECTED);
+    }
+    if (state == CONN_STATE_ONLINE) {
+        link |= LED_STATUS_MQTT_UP;
+    }
+    if (state == CONN_STATE_WIFI_CONNECTING || state == CONN_STATE_MQTT_CONNECTING) {
+        link |= LED_STATUS_CONNECTING;
+    }
+    led_update(LED_STATUS_LINK_MASK, link);
+}
+
+static void on_wifi_connected(void)
+{
+    // Start MQTT on the first connection; the connectivity controller schedules reconnects afterwards
+    if (mqtt_client != NULL) {
+        return;
+    }
+    
+    if (mqtt_init() != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to initialize MQTT");
     }
 }
 
+static esp_err_t start_network(void)
+{
+    // MQTT is started from the WiFi connected callback, not after a fixed delay
+    wifi_set_connected_callback(on_wifi_connected);
+    connectivity_set_state_callback(on_connectivity_changed);
+    
+    esp_err_t ret = wifi_init();
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to initialize WiFi: %s", esp_err_to_name(ret));
+        return ret;
+    }
+    
+    // Sleep-build nodes on the same channel; their events reach MQTT through this device
+    if (ESPNOW_GATEWAY_ENABLE && espnow_gateway_init() != ESP_OK) {
+        ESP_LOGW(TAG, "ESP-NOW gateway unavailable");
+    }
+    
+    return ESP_OK;
+}
+
+// ----------------- Runtime settings -----------------
+static void on_settings_changed(void)
+{
+    // Timers need restarting; everything else reads the settings struct directly
+    telemetry_set_interval(settings_get()->telemetry_interval_s);
+}
+
 // ----------------- Initialize all components -----------------
 static esp_err_t init_components(void)
 {
@@ -186,30 +305,49 @@ static esp_err_t init_components(void)
         ret = nvs_flash_init();
     }
     ESP_ERROR_CHECK(ret);
+    boot_profile_mark(BOOT_PHASE_NVS);
     
-    // Initialize WiFi
-    ret = wifi_init();
+    // Hot-path messages go to the RAM ring and are formatted only when drained
+    if (binlog_init() != ESP_OK) {
+        ESP_LOGW(TAG, "Binary log UART drain unavailable");
+    }
+    
+    // Runtime tunables; defaults from config.h are used if NVS holds none
+    ret = settings_init();
     if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to initialize WiFi: %s", esp_err_to_name(ret));
-        return ret;
+        ESP_LOGW(TAG, "Settings not persistent: %s", esp_err_to_name(ret));
     }
+    settings_set_change_callback(on_settings_changed);
+    boot_profile_mark(BOOT_PHASE_SETTINGS);
     
-    // Wait a bit for WiFi to connect
-    vTaskDelay(pdMS_TO_TICKS(3000));
+    // Persistent outbox for door events raised while MQTT is not connected
+    ret = outbox_init();
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to initialize outbox: %s", esp_err_to_name(ret));
+        return ret;
+    }
     
-    // Initialize MQTT
-    ret = mqtt_init();
+    // Starts the rollback deadline of a freshly updated image before anything can hang
+    ret = ota_init();
     if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to initialize MQTT: %s", esp_err_to_name(ret));
-        // Don't return error, continue without MQTT
+        ESP_LOGW(TAG, "Firmware updates unavailable: %s", esp_err_to_name(ret));
     }
+    boot_profile_mark(BOOT_PHASE_OUTBOX);
     
     // Initialize Hall sensor
-    ret = hall_sensor_init();
+    ret = hall_sensor_init(hall_channels, sizeof(hall_channels) / sizeof(hall_channels[0]));
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "Failed to initialize Hall sensor: %s", esp_err_to_name(ret));
         return ret;
     }
+    boot_profile_mark(BOOT_PHASE_SENSOR);
+    
+    // Publish stage: coalesces bursts and feeds the outbox while offline; needs the Hall channel table
+    ret = publisher_init();
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to initialize publisher: %s", esp_err_to_name(ret));
+        return ret;
+    }
     
     // Initialize buzzer
     ret = buzzer_init();
@@ -218,16 +356,67 @@ static esp_err_t init_components(void)
         return ret;
     }
     
+    // Status LED, driven by connectivity, door and alarm state
+    ret = led_init();
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to initialize LED: %s", esp_err_to_name(ret));
+        return ret;
+    }
+    // Door bit as the debounced state starts out; door_log_task tracks it from the first event
+    led_update(LED_STATUS_DOOR_OPEN, hall_sensor_get_channel_count() ? LED_STATUS_DOOR_OPEN : 0);
+    boot_profile_mark(BOOT_PHASE_DRIVERS);
+    
+    // Status payload template and periodic report
+    ret = telemetry_init();
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to initialize telemetry: %s", esp_err_to_name(ret));
+        return ret;
+    }
+    
+    // Command table and worker task for MQTT commands
+    ret = command_init();
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to initialize command dispatcher: %s", esp_err_to_name(ret));
+        return ret;
+    }
+    
+    // Door-ajar and forced-entry rules on the door event stream
+    ret = door_rules_init();
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to initialize door rules: %s", esp_err_to_name(ret));
+        return ret;
+    }
+    boot_profile_mark(BOOT_PHASE_SERVICES);
+    
     return ESP_OK;
 }
 
 // ----------------- Create tasks -----------------
 static esp_err_t create_tasks(void)
 {
+    // Subscribers are registered before the Hall task can post (the publisher subscribed in its init)
+    chime_queue = event_bus_subscribe("chime", CHIME_QUEUE_LEN, RTOS_QUEUE(chime));
+    door_log_queue = event_bus_subscribe("door_log", DOOR_LOG_QUEUE_LEN, RTOS_QUEUE(door_log));
+    if (chime_queue == NULL || door_log_queue == NULL) {
+        ESP_LOGE(TAG, "Failed to subscribe to door events");
+        return ESP_FAIL;
+    }
+    
+    esp_err_t ret = rtos_task_create(chime_task, "chime", BUZZER_TASK_STACK_SIZE, NULL,
+                                     BUZZER_TASK_PRIORITY, RTOS_CORE_SENSOR, RTOS_TASK(chime_task), NULL);
+    if (ret == ESP_OK) {
+        ret = rtos_task_create(door_log_task, "door_log", DOOR_LOG_TASK_STACK_SIZE, NULL,
+                               DOOR_LOG_TASK_PRIORITY, RTOS_CORE_NETWORK, RTOS_TASK(door_log_task), NULL);
+    }
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to create door event subscriber tasks");
+        return ESP_FAIL;
+    }
+    
     // Create Hall sensor task
-    BaseType_t ret = xTaskCreate(hall_task, "hall_task", HALL_TASK_STACK_SIZE, 
-                                 NULL, HALL_TASK_PRIORITY, NULL);
-    if (ret != pdPASS) {
+    ret = rtos_task_create(hall_task, "hall_task", HALL_TASK_STACK_SIZE, NULL,
+                           HALL_TASK_PRIORITY, RTOS_CORE_SENSOR, RTOS_TASK(hall_task), NULL);
+    if (ret != ESP_OK) {
         ESP_LOGE(TAG, "Failed to create Hall sensor task");
         return ESP_FAIL;
     }
@@ -237,8 +426,10 @@ static esp_err_t create_tasks(void)
 
 void app_main(void)
 {
- 
-    // Initialize all components and create tasks
+    // Profiling build only: starts this boot's record in RTC memory
+    boot_profile_begin();
+    
+    // Bring up the hardware first so door events are captured during network startup
     if (init_components() != ESP_OK) {
         ESP_LOGE(TAG, "Failed to initialize components");
         return;
@@ -249,16 +440,27 @@ void app_main(void)
         ESP_LOGE(TAG, "Failed to create tasks");
         return;
     }
+    boot_profile_mark(BOOT_PHASE_TASKS);
+    
+    // Connect in the background; MQTT starts once an IP is obtained
+    if (start_network() != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to start network");
+        return;
+    }
+    boot_profile_mark(BOOT_PHASE_WIFI_START);
 
-    // Enable WiFi power save (highest savings while connected)
-    esp_wifi_set_ps(WIFI_PS_MAX_MODEM);
+    // Max modem sleep while idle, low-latency settings after door events and commands
+    if (power_policy_init() != ESP_OK) {
+        ESP_LOGW(TAG, "Power policy unavailable, keeping default power save");
+    }
+    
+    // Serial diagnostics (latency histograms, debounce statistics)
+    if (CONSOLE_ENABLE && console_init() != ESP_OK) {
+        ESP_LOGW(TAG, "Console unavailable");
+    }
     
     ESP_LOGI(TAG, "System initialized successfully");
     ESP_LOGI(TAG, "Monitoring Hall sensor...");
     
-    // Main loop - handle buzzer updates
-    while (1) {
-        buzzer_update();
-        vTaskDelay(pdMS_TO_TICKS(10));
-    }
+    // Everything runs from tasks, timers and event handlers; the main task can exit
 }
@@ -0,0 +1,57 @@
+#include "mqtt_config.h"
+#include "config.h"
+#include "esp_log.h"
+#include "esp_mac.h"
+#include "esp_crt_bundle.h"
+#include <stdio.h>
+
+static const char *TAG = "MQTT_CONFIG";
+
+// esp_mqtt_client_init() copies these, static storage keeps them valid regardless
+static char mqtt_uri[96];
+static char mqtt_client_id[48];
+
+esp_err_t mqtt_config_build(esp_mqtt_client_config_t *cfg)
+{
+    if (cfg == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    snprintf(mqtt_uri, sizeof(mqtt_uri), "%s://%s:%d",
+             MQTT_TLS_ENABLE ? "mqtts" : "mqtt", MQTT_SERVER, MQTT_PORT);
+    cfg->broker.address.uri = mqtt_uri;
+    
+    if (MQTT_TLS_ENABLE) {
+        // A private broker CA from config.h, otherwise the bundled public root CAs
+        static const char *const ca_pem = MQTT_TLS_CA_PEM;
+        static const char *const common_name = MQTT_TLS_COMMON_NAME;
+        if (ca_pem != NULL) {
+            cfg->broker.verification.certificate = ca_pem;
+        } else {
+            cfg->broker.verification.crt_bundle_attach = esp_crt_bundle_attach;
+        }
+        cfg->broker.verification.common_name = common_name;
+    } else {
+        ESP_LOGW(TAG, "TLS disabled, credentials and door events are sent in plaintext");
+    }
+    
+    // Persistent sessions are keyed by client id, so it must be unique per device
+    uint8_t mac[6] = {0};
+    esp_err_t ret = esp_read_mac(mac, ESP_MAC_WIFI_STA);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to read MAC address: %s", esp_err_to_name(ret));
+        return ret;
+    }
+    snprintf(mqtt_client_id, sizeof(mqtt_client_id), "%s_%02x%02x%02x",
+             MQTT_CLIENT_ID, mac[3], mac[4], mac[5]);
+    
+    cfg->credentials.client_id = mqtt_client_id;
+    cfg->credentials.username = MQTT_USERNAME;
+    cfg->credentials.authentication.password = MQTT_PASSWORD;
+    cfg->session.keepalive = MQTT_KEEPALIVE_S;
+    cfg->session.disable_clean_session = MQTT_PERSISTENT_SESSION;
+    
+    ESP_LOGI(TAG, "Broker %s, client id %s%s", mqtt_uri, mqtt_client_id,
+             MQTT_PERSISTENT_SESSION ? " (persistent session)" : "");
+    return ESP_OK;
+}
@@ -0,0 +1,16 @@
+#ifndef MQTT_CONFIG_H
+#define MQTT_CONFIG_H
+
+#include "esp_err.h"
+#include "mqtt_client.h"
+
+/**
+ * @brief Fill an MQTT client configuration from config.h
+ * Broker URI (mqtt:// or mqtts:// with CA verification), credentials, a per-device
+ * client id and the session options. Shared by the always-on and deep-sleep builds.
+ * @param cfg Configuration to fill; other fields are left untouched
+ * @return ESP_OK on success, error code on failure
+ */
+esp_err_t mqtt_config_build(esp_mqtt_client_config_t *cfg);
+
+#endif // MQTT_CONFIG_H
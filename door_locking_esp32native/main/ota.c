@@ -0,0 +1,285 @@
+#include "ota.h"
+#include "config.h"
+#include "publisher.h"
+#include "power_policy.h"
+#include "outbox.h"
+#include "rtos_alloc.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_random.h"
+#include "esp_system.h"
+#include "esp_ota_ops.h"
+#include "esp_https_ota.h"
+#include "esp_http_client.h"
+#include "esp_crt_bundle.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+
+static const char *TAG = "OTA";
+
+#define OTA_NOTIFY_START    0x01
+#define OTA_NOTIFY_ONLINE   0x02
+#define OTA_PROGRESS_STEP   25      // Percent between progress reports
+
+static const char *const state_names[] = {
+    [OTA_STATE_IDLE]           = "idle",
+    [OTA_STATE_PENDING_VERIFY] = "pending_verify",
+    [OTA_STATE_VALID]          = "valid",
+    [OTA_STATE_ROLLED_BACK]    = "rolled_back",
+    [OTA_STATE_WAITING]        = "waiting",
+    [OTA_STATE_DOWNLOADING]    = "downloading",
+    [OTA_STATE_UP_TO_DATE]     = "up_to_date",
+    [OTA_STATE_FAILED]         = "failed",
+    [OTA_STATE_REBOOTING]      = "rebooting",
+};
+
+static _Atomic ota_state_t current_state = OTA_STATE_IDLE;
+static atomic_bool update_running = false;
+
+// Written by the update task only
+static char target_version[32] = "";
+static int progress_percent = 0;
+static esp_err_t last_error = ESP_OK;
+
+// Rolls a pending image back if MQTT is not reached in time
+static esp_timer_handle_t verify_timer = NULL;
+
+static TaskHandle_t ota_task_handle = NULL;
+RTOS_TASK_STORAGE(ota, OTA_TASK_STACK_SIZE);
+
+static void ota_publish_state(void)
+{
+    char payload[192];
+    int len = snprintf(payload, sizeof(payload),
+                       "{\"state\":\"%s\",\"version\":\"%s\",\"target\":\"%s\",\"progress\":%d,"
+                       "\"error\":\"%s\",\"boot\":%u}",
+                       state_names[ota_get_state()], esp_app_get_description()->version, target_version,
+                       progress_percent, last_error == ESP_OK ? "" : esp_err_to_name(last_error),
+                       outbox_boot_id());
+    
+    // Not queued while offline; the state is republished on every reconnect
+    publisher_publish(MQTT_TOPIC_OTA, payload, len, true);
+}
+
+static void set_state(ota_state_t new_state)
+{
+    atomic_store(&current_state, new_state);
+    ESP_LOGI(TAG, "State %s", state_names[new_state]);
+    ota_publish_state();
+}
+
+/**
+ * @brief Verification deadline expired (esp_timer task context)
+ */
+static void verify_timer_callback(void *arg)
+{
+    ESP_LOGE(TAG, "New image did not reach MQTT within %us, rolling back", (unsigned)OTA_VERIFY_TIMEOUT_S);
+    esp_ota_mark_app_invalid_rollback_and_reboot();
+}
+
+/**
+ * @brief Mark a pending image valid once it has reached the broker (update task)
+ */
+static void ota_confirm(void)
+{
+    if (ota_get_state() != OTA_STATE_PENDING_VERIFY) {
+        return;
+    }
+    
+    esp_timer_stop(verify_timer);
+    esp_err_t ret = esp_ota_mark_app_valid_cancel_rollback();
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to confirm image: %s", esp_err_to_name(ret));
+        return;
+    }
+    atomic_store(&current_state, OTA_STATE_VALID);
+    ESP_LOGI(TAG, "Image %s confirmed", esp_app_get_description()->version);
+}
+
+static esp_err_t ota_download(void)
+{
+    esp_http_client_config_t http_config = {
+        .url = OTA_URL,
+        .crt_bundle_attach = esp_crt_bundle_attach,
+        .timeout_ms = OTA_HTTP_TIMEOUT_MS,
+        .keep_alive_enable = true,
+    };
+    esp_https_ota_config_t ota_config = {
+        .http_config = &http_config,
+    };
+    
+    esp_https_ota_handle_t handle = NULL;
+    esp_err_t ret = esp_https_ota_begin(&ota_config, &handle);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to start download: %s", esp_err_to_name(ret));
+        return ret;
+    }
+    
+    // Only the image header has been read so far; an unchanged version is not downloaded
+    esp_app_desc_t new_desc;
+    ret = esp_https_ota_get_img_desc(handle, &new_desc);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to read image header: %s", esp_err_to_name(ret));
+        esp_https_ota_abort(handle);
+        return ret;
+    }
+    snprintf(target_version, sizeof(target_version), "%s", new_desc.version);
+    if (strncmp(new_desc.version, esp_app_get_description()->version, sizeof(new_desc.version)) == 0) {
+        esp_https_ota_abort(handle);
+        set_state(OTA_STATE_UP_TO_DATE);
+        return ESP_OK;
+    }
+    
+    set_state(OTA_STATE_DOWNLOADING);
+    int image_size = esp_https_ota_get_image_size(handle);
+    int next_report = OTA_PROGRESS_STEP;
+    
+    // One buffer per call; this task has the lowest application priority, so every
+    // other task on the network core runs first
+    do {
+        power_policy_notify(POWER_ACTIVITY_OTA);
+        ret = esp_https_ota_perform(handle);
+        
+        if (image_size > 0) {
+            progress_percent = (int)((int64_t)esp_https_ota_get_image_len_read(handle) * 100 / image_size);
+            if (progress_percent >= next_report && progress_percent < 100) {
+                ota_publish_state();
+                next_report = progress_percent - progress_percent % OTA_PROGRESS_STEP + OTA_PROGRESS_STEP;
+            }
+        }
+    } while (ret == ESP_ERR_HTTPS_OTA_IN_PROGRESS);
+    
+    if (ret != ESP_OK || !esp_https_ota_is_complete_data_received(handle)) {
+        ESP_LOGE(TAG, "Download failed: %s", esp_err_to_name(ret));
+        esp_https_ota_abort(handle);
+        return ret != ESP_OK ? ret : ESP_ERR_INVALID_SIZE;
+    }
+    
+    // Validates the image and selects it for the next boot
+    ret = esp_https_ota_finish(handle);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Image rejected: %s", esp_err_to_name(ret));
+        return ret;
+    }
+    
+    progress_percent = 100;
+    set_state(OTA_STATE_REBOOTING);
+    vTaskDelay(pdMS_TO_TICKS(OTA_REBOOT_DELAY_MS));   // Let the state publish leave
+    esp_restart();
+    return ESP_OK;
+}
+
+static void ota_run(void)
+{
+    last_error = ESP_OK;
+    progress_percent = 0;
+    target_version[0] = '\0';
+    
+    // Spread a fleet-wide command over OTA_START_JITTER_S
+    uint32_t delay_ms = OTA_START_JITTER_S > 0 ? esp_random() % (OTA_START_JITTER_S * 1000) : 0;
+    set_state(OTA_STATE_WAITING);
+    ESP_LOGI(TAG, "Starting download of %s in %lums", OTA_URL, (unsigned long)delay_ms);
+    vTaskDelay(pdMS_TO_TICKS(delay_ms));
+    
+    esp_err_t ret = ota_download();
+    if (ret != ESP_OK) {
+        last_error = ret;
+        set_state(OTA_STATE_FAILED);
+    }
+    atomic_store(&update_running, false);
+}
+
+// ----------------- Update task -----------------
+static void ota_task(void *pvParameters)
+{
+    uint32_t bits;
+    
+    while (1) {
+        xTaskNotifyWait(0, UINT32_MAX, &bits, portMAX_DELAY);
+        
+        if (bits & OTA_NOTIFY_ONLINE) {
+            ota_confirm();
+            ota_publish_state();
+        }
+        if (bits & OTA_NOTIFY_START) {
+            ota_run();
+        }
+    }
+}
+
+esp_err_t ota_init(void)
+{
+    const esp_partition_t *running = esp_ota_get_running_partition();
+    esp_ota_img_states_t image_state;
+    
+    if (esp_ota_get_state_partition(running, &image_state) == ESP_OK &&
+        image_state == ESP_OTA_IMG_PENDING_VERIFY) {
+        const esp_timer_create_args_t timer_args = {
+            .callback = verify_timer_callback,
+            .arg = NULL,
+            .dispatch_method = ESP_TIMER_TASK,
+            .name = "ota_verify",
+        };
+        esp_err_t ret = esp_timer_create(&timer_args, &verify_timer);
+        if (ret != ESP_OK) {
+            // Without the deadline the bootloader still rolls back if this image resets
+            ESP_LOGE(TAG, "Failed to create verify timer: %s", esp_err_to_name(ret));
+        } else {
+            esp_timer_start_once(verify_timer, (uint64_t)OTA_VERIFY_TIMEOUT_S * 1000000ULL);
+        }
+        atomic_store(&current_state, OTA_STATE_PENDING_VERIFY);
+    } else if (esp_ota_get_last_invalid_partition() != NULL) {
+        atomic_store(&current_state, OTA_STATE_ROLLED_BACK);
+    }
+    
+    esp_err_t ret = rtos_task_create(ota_task, "ota", OTA_TASK_STACK_SIZE, NULL,
+                                     OTA_TASK_PRIORITY, RTOS_CORE_NETWORK, RTOS_TASK(ota), &ota_task_handle);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to create OTA task");
+        return ret;
+    }
+    
+    ESP_LOGI(TAG, "Running %s from %s (%s)", esp_app_get_description()->version, running->label,
+             state_names[ota_get_state()]);
+    return ESP_OK;
+}
+
+esp_err_t ota_start(void)
+{
+    if (ota_task_handle == NULL) {
+        return ESP_FAIL;
+    }
+    
+    // A pending image must prove itself before it may be replaced
+    bool expected = false;
+    if (ota_get_state() == OTA_STATE_PENDING_VERIFY ||
+        !atomic_compare_exchange_strong(&update_running, &expected, true)) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    
+    xTaskNotify(ota_task_handle, OTA_NOTIFY_START, eSetBits);
+    return ESP_OK;
+}
+
+void ota_on_online(void)
+{
+    if (ota_task_handle != NULL) {
+        xTaskNotify(ota_task_handle, OTA_NOTIFY_ONLINE, eSetBits);
+    }
+}
+
+ota_state_t ota_get_state(void)
+{
+    return atomic_load(&current_state);
+}
+
+const char *ota_state_name(ota_state_t state)
+{
+    if (state > OTA_STATE_REBOOTING) {
+        return "?";
+    }
+    return state_names[state];
+}
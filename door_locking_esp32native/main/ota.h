@@ -0,0 +1,56 @@
+#ifndef OTA_H
+#define OTA_H
+
+#include <stdbool.h>
+#include "esp_err.h"
+
+/**
+ * @brief Update state, reported as "state" on MQTT_TOPIC_OTA
+ */
+typedef enum {
+    OTA_STATE_IDLE = 0,
+    OTA_STATE_PENDING_VERIFY,   // New image running, rolled back unless MQTT is reached in time
+    OTA_STATE_VALID,            // New image confirmed after reaching MQTT
+    OTA_STATE_ROLLED_BACK,      // The previous update never reached MQTT and was reverted
+    OTA_STATE_WAITING,          // Start delayed by the rollout jitter
+    OTA_STATE_DOWNLOADING,
+    OTA_STATE_UP_TO_DATE,       // Server image has the running version; nothing was downloaded
+    OTA_STATE_FAILED,
+    OTA_STATE_REBOOTING,
+} ota_state_t;
+
+/**
+ * @brief Check the running image and start the update task
+ * A freshly updated image that is still pending verification gets OTA_VERIFY_TIMEOUT_S
+ * to reach the MQTT broker before the device rolls back to the previous image.
+ * @return ESP_OK on success, error code on failure
+ */
+esp_err_t ota_init(void);
+
+/**
+ * @brief Start downloading OTA_URL in the background
+ * Waits a random 0 to OTA_START_JITTER_S first, so a fleet-wide command does not hit the server at once.
+ * @return ESP_OK if started, ESP_ERR_INVALID_STATE if an update is already in progress
+ */
+esp_err_t ota_start(void);
+
+/**
+ * @brief Report that MQTT is connected; confirms a pending image and publishes the update state
+ * Only notifies the update task, so it is safe to call from event callbacks.
+ */
+void ota_on_online(void);
+
+/**
+ * @brief Get the current update state
+ * @return State
+ */
+ota_state_t ota_get_state(void);
+
+/**
+ * @brief Get the short name of a state ("downloading", ...)
+ * @param state State
+ * @return Name, or "?" for an unknown state
+ */
+const char *ota_state_name(ota_state_t state);
+
+#endif // OTA_H
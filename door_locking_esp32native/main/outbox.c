@@ -0,0 +1,172 @@
+#include "outbox.h"
+#include "config.h"
+#include "rtos_alloc.h"
+#include "esp_log.h"
+#include "nvs.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include <stdio.h>
+
+static const char *TAG = "OUTBOX";
+
+// NVS layout: one blob per ring slot plus head/tail ring indices.
+// NVS itself is append-only and wear-leveled, so a slot rewrite never
+// erases a flash sector in place.
+#define OUTBOX_NVS_NS       "outbox"
+#define OUTBOX_KEY_HEAD     "head"   // Ring index of the next record
+#define OUTBOX_KEY_TAIL     "tail"   // Ring index of the oldest undelivered record
+#define OUTBOX_KEY_BOOT     "boot"
+
+static nvs_handle_t outbox_nvs = 0;
+static SemaphoreHandle_t outbox_mutex = NULL;
+RTOS_MUTEX_STORAGE(outbox);
+static uint32_t outbox_head = 0;
+static uint32_t outbox_tail = 0;
+static uint32_t outbox_dropped_count = 0;
+static uint16_t boot_id = 0;
+
+static void outbox_slot_key(uint32_t index, char *key, size_t key_len)
+{
+    snprintf(key, key_len, "r%03lu", (unsigned long)(index % OUTBOX_CAPACITY));
+}
+
+esp_err_t outbox_init(void)
+{
+    outbox_mutex = rtos_mutex_create(RTOS_MUTEX(outbox));
+    if (outbox_mutex == NULL) {
+        ESP_LOGE(TAG, "Failed to create outbox mutex");
+        return ESP_FAIL;
+    }
+    
+    esp_err_t ret = nvs_open(OUTBOX_NVS_NS, NVS_READWRITE, &outbox_nvs);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to open outbox namespace: %s", esp_err_to_name(ret));
+        vSemaphoreDelete(outbox_mutex);
+        outbox_mutex = NULL;
+        return ret;
+    }
+    
+    // Missing keys simply mean an empty outbox
+    uint32_t boot = 0;
+    nvs_get_u32(outbox_nvs, OUTBOX_KEY_HEAD, &outbox_head);
+    nvs_get_u32(outbox_nvs, OUTBOX_KEY_TAIL, &outbox_tail);
+    nvs_get_u32(outbox_nvs, OUTBOX_KEY_BOOT, &boot);
+    
+    if (outbox_head - outbox_tail > OUTBOX_CAPACITY) {
+        ESP_LOGW(TAG, "Outbox indices inconsistent, resetting tail");
+        outbox_tail = outbox_head;
+    }
+    
+    boot_id = (uint16_t)(boot + 1);
+    nvs_set_u32(outbox_nvs, OUTBOX_KEY_BOOT, boot_id);
+    nvs_commit(outbox_nvs);
+    
+    ESP_LOGI(TAG, "Outbox initialized: %lu pending, boot %u",
+             (unsigned long)(outbox_head - outbox_tail), boot_id);
+    return ESP_OK;
+}
+
+esp_err_t outbox_append(const outbox_record_t *record)
+{
+    if (outbox_mutex == NULL || record == NULL) {
+        return ESP_FAIL;
+    }
+    
+    xSemaphoreTake(outbox_mutex, portMAX_DELAY);
+    
+    // Full: overwrite the oldest record
+    if (outbox_head - outbox_tail >= OUTBOX_CAPACITY) {
+        outbox_tail++;
+        outbox_dropped_count++;
+        nvs_set_u32(outbox_nvs, OUTBOX_KEY_TAIL, outbox_tail);
+        ESP_LOGW(TAG, "Outbox full, dropped oldest record");
+    }
+    
+    char key[8];
+    outbox_slot_key(outbox_head, key, sizeof(key));
+    esp_err_t ret = nvs_set_blob(outbox_nvs, key, record, sizeof(*record));
+    if (ret == ESP_OK) {
+        outbox_head++;
+        nvs_set_u32(outbox_nvs, OUTBOX_KEY_HEAD, outbox_head);
+        ret = nvs_commit(outbox_nvs);
+    }
+    
+    xSemaphoreGive(outbox_mutex);
+    
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to store outbox record: %s", esp_err_to_name(ret));
+    }
+    return ret;
+}
+
+size_t outbox_peek(outbox_record_t *records, size_t max_records, uint32_t *end_index)
+{
+    if (outbox_mutex == NULL || records == NULL || end_index == NULL) {
+        return 0;
+    }
+    
+    xSemaphoreTake(outbox_mutex, portMAX_DELAY);
+    
+    size_t count = 0;
+    uint32_t index = outbox_tail;
+    while (index != outbox_head && count < max_records) {
+        char key[8];
+        size_t len = sizeof(outbox_record_t);
+        outbox_slot_key(index, key, sizeof(key));
+        
+        if (nvs_get_blob(outbox_nvs, key, &records[count], &len) == ESP_OK &&
+            len == sizeof(outbox_record_t)) {
+            count++;
+        } else if (count == 0) {
+            // Unreadable record at the tail - skip it so replay cannot stall
+            ESP_LOGW(TAG, "Outbox record %lu unreadable, skipping", (unsigned long)index);
+            outbox_tail++;
+            outbox_dropped_count++;
+            nvs_set_u32(outbox_nvs, OUTBOX_KEY_TAIL, outbox_tail);
+            nvs_commit(outbox_nvs);
+        } else {
+            break;
+        }
+        index++;
+    }
+    *end_index = index;
+    
+    xSemaphoreGive(outbox_mutex);
+    return count;
+}
+
+esp_err_t outbox_consume_until(uint32_t end_index)
+{
+    if (outbox_mutex == NULL) {
+        return ESP_FAIL;
+    }
+    
+    xSemaphoreTake(outbox_mutex, portMAX_DELAY);
+    
+    // Records dropped meanwhile may already have moved the tail past end_index
+    if ((int32_t)(end_index - outbox_tail) > 0 && (int32_t)(outbox_head - end_index) >= 0) {
+        outbox_tail = end_index;
+    }
+    
+    // One commit per delivered batch
+    nvs_set_u32(outbox_nvs, OUTBOX_KEY_TAIL, outbox_tail);
+    esp_err_t ret = nvs_commit(outbox_nvs);
+    
+    xSemaphoreGive(outbox_mutex);
+    return ret;
+}
+
+uint32_t outbox_pending(void)
+{
+    return outbox_head - outbox_tail;
+}
+
+uint16_t outbox_boot_id(void)
+{
+    return boot_id;
+}
+
+uint32_t outbox_dropped(void)
+{
+    return outbox_dropped_count;
+}
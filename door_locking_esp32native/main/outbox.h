@@ -0,0 +1,70 @@
+#ifndef OUTBOX_H
+#define OUTBOX_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+#define OUTBOX_STATE_OPEN           0x01  // Door open; clear = closed
+#define OUTBOX_STATE_CHANNEL_SHIFT  1     // Hall channel index in the upper 7 bits
+
+/**
+ * @brief Door event stored in the persistent outbox (12 bytes)
+ */
+typedef struct {
+    uint32_t seq;            // Event sequence number within the boot
+    uint32_t timestamp_ms;   // Milliseconds since boot when the event happened
+    uint16_t boot_id;        // Boot counter; (boot_id, seq) identifies an event
+    uint8_t state;           // OUTBOX_STATE_OPEN | channel << OUTBOX_STATE_CHANNEL_SHIFT
+    uint8_t bounce_count;    // Debounce rejections before the transition
+} outbox_record_t;
+
+/**
+ * @brief Initialize the outbox and load its ring indices from NVS
+ * NVS must already be initialized.
+ * @return ESP_OK on success, error code on failure
+ */
+esp_err_t outbox_init(void);
+
+/**
+ * @brief Append a door event to the outbox (oldest record is dropped when full)
+ * @param record Event to store
+ * @return ESP_OK on success, error code on failure
+ */
+esp_err_t outbox_append(const outbox_record_t *record);
+
+/**
+ * @brief Copy the oldest pending records without removing them
+ * @param records Buffer receiving the records, oldest first
+ * @param max_records Capacity of the buffer
+ * @param end_index Set to the ring index following the last copied record
+ * @return Number of records copied
+ */
+size_t outbox_peek(outbox_record_t *records, size_t max_records, uint32_t *end_index);
+
+/**
+ * @brief Remove delivered records
+ * @param end_index Ring index returned by outbox_peek() for the delivered batch
+ * @return ESP_OK on success, error code on failure
+ */
+esp_err_t outbox_consume_until(uint32_t end_index);
+
+/**
+ * @brief Get number of records waiting to be delivered
+ * @return Pending record count
+ */
+uint32_t outbox_pending(void);
+
+/**
+ * @brief Get the boot counter stored with every record
+ * @return Boot id of the running firmware
+ */
+uint16_t outbox_boot_id(void);
+
+/**
+ * @brief Get number of records dropped because the outbox was full
+ * @return Dropped record count since boot
+ */
+uint32_t outbox_dropped(void);
+
+#endif // OUTBOX_H
@@ -0,0 +1,135 @@
+#include "power_policy.h"
+#include "config.h"
+#include "settings.h"
+#include "rtos_alloc.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_wifi.h"
+#include "esp_pm.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+static const char *TAG = "POWER";
+
+static const char *activity_names[] = {
+    [POWER_ACTIVITY_DOOR] = "door",
+    [POWER_ACTIVITY_COMMAND] = "command",
+    [POWER_ACTIVITY_MQTT_TX] = "mqtt",
+    [POWER_ACTIVITY_OTA] = "ota",
+};
+
+static SemaphoreHandle_t policy_mutex = NULL;
+RTOS_MUTEX_STORAGE(policy);
+static esp_timer_handle_t idle_timer = NULL;
+static bool boosted = false;
+static int64_t boost_until_us = 0;  // Low-latency mode is kept until this time
+
+static void set_power_save(wifi_ps_type_t mode)
+{
+    // ESP-NOW frames are only heard while the radio is awake; the gateway is mains powered
+    if (ESPNOW_GATEWAY_ENABLE) {
+        mode = WIFI_PS_NONE;
+    }
+    
+    esp_err_t ret = esp_wifi_set_ps(mode);
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to set power save mode %d: %s", (int)mode, esp_err_to_name(ret));
+    }
+}
+
+/**
+ * @brief Drop back to idle power save once no activity extended the hold (esp_timer task)
+ */
+static void idle_timer_callback(void *arg)
+{
+    xSemaphoreTake(policy_mutex, portMAX_DELAY);
+    
+    int64_t remaining_us = boost_until_us - esp_timer_get_time();
+    if (remaining_us > 0) {
+        // Activity arrived meanwhile - sleep until the new deadline
+        esp_timer_start_once(idle_timer, remaining_us);
+    } else if (boosted) {
+        boosted = false;
+        wifi_ps_type_t mode = (wifi_ps_type_t)settings_get()->idle_ps_mode;
+        set_power_save(mode);
+        ESP_LOGI(TAG, "Idle, back to power save mode %d", (int)mode);
+    }
+    
+    xSemaphoreGive(policy_mutex);
+}
+
+/**
+ * @brief Enable DFS and automatic light sleep (needs CONFIG_PM_ENABLE and tickless idle)
+ */
+static void configure_pm(void)
+{
+    esp_pm_config_t pm_config = {
+        .max_freq_mhz = POWER_PM_MAX_FREQ_MHZ,
+        .min_freq_mhz = POWER_PM_MIN_FREQ_MHZ,
+        .light_sleep_enable = POWER_LIGHT_SLEEP_ENABLE,
+    };
+    
+    esp_err_t ret = esp_pm_configure(&pm_config);
+    if (ret == ESP_ERR_NOT_SUPPORTED) {
+        ESP_LOGW(TAG, "Power management disabled in sdkconfig, running at fixed clock");
+    } else if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to configure power management: %s", esp_err_to_name(ret));
+    } else {
+        ESP_LOGI(TAG, "DFS %d-%dMHz, light sleep %s", POWER_PM_MIN_FREQ_MHZ, POWER_PM_MAX_FREQ_MHZ,
+                 POWER_LIGHT_SLEEP_ENABLE ? "enabled" : "disabled");
+    }
+}
+
+esp_err_t power_policy_init(void)
+{
+    policy_mutex = rtos_mutex_create(RTOS_MUTEX(policy));
+    if (policy_mutex == NULL) {
+        ESP_LOGE(TAG, "Failed to create power policy mutex");
+        return ESP_FAIL;
+    }
+    
+    const esp_timer_create_args_t timer_args = {
+        .callback = idle_timer_callback,
+        .arg = NULL,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "power_idle",
+    };
+    
+    esp_err_t ret = esp_timer_create(&timer_args, &idle_timer);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to create idle timer: %s", esp_err_to_name(ret));
+        vSemaphoreDelete(policy_mutex);
+        policy_mutex = NULL;
+        return ret;
+    }
+    
+    configure_pm();
+    const settings_t *settings = settings_get();
+    set_power_save((wifi_ps_type_t)settings->idle_ps_mode);
+    
+    ESP_LOGI(TAG, "Power policy initialized (idle mode %d, boost mode %d for %lums)",
+             settings->idle_ps_mode, settings->boost_ps_mode, (unsigned long)settings->boost_hold_ms);
+    return ESP_OK;
+}
+
+void power_policy_notify(power_activity_t reason)
+{
+    if (policy_mutex == NULL) {
+        return;
+    }
+    
+    xSemaphoreTake(policy_mutex, portMAX_DELAY);
+    
+    // Extend the deadline; an already running timer re-arms itself for it
+    uint32_t hold_ms = settings_get()->boost_hold_ms;
+    boost_until_us = esp_timer_get_time() + (int64_t)hold_ms * 1000;
+    
+    if (!boosted) {
+        boosted = true;
+        set_power_save((wifi_ps_type_t)settings_get()->boost_ps_mode);
+        esp_timer_start_once(idle_timer, (uint64_t)hold_ms * 1000);
+        ESP_LOGI(TAG, "Low-latency mode (%s)", activity_names[reason]);
+    }
+    
+    xSemaphoreGive(policy_mutex);
+}
@@ -0,0 +1,30 @@
+#ifndef POWER_POLICY_H
+#define POWER_POLICY_H
+
+#include "esp_err.h"
+
+/**
+ * @brief Reasons for leaving modem sleep
+ */
+typedef enum {
+    POWER_ACTIVITY_DOOR = 0,   // Debounced Hall transition
+    POWER_ACTIVITY_COMMAND,    // Inbound MQTT command
+    POWER_ACTIVITY_MQTT_TX,    // Outgoing MQTT traffic still waiting for acknowledgement
+    POWER_ACTIVITY_OTA,        // Firmware download in progress
+} power_activity_t;
+
+/**
+ * @brief Initialize the power policy, enable DFS/light sleep and enter the idle power-save mode
+ * Call after WiFi has been started.
+ * @return ESP_OK on success, error code on failure
+ */
+esp_err_t power_policy_init(void);
+
+/**
+ * @brief Report activity; keeps low-latency modem settings for POWER_BOOST_HOLD_MS
+ * Safe to call from any task, not from an ISR.
+ * @param reason What caused the activity
+ */
+void power_policy_notify(power_activity_t reason);
+
+#endif // POWER_POLICY_H
@@ -0,0 +1,384 @@
+#include "publisher.h"
+#include "config.h"
+#include "binlog.h"
+#include "outbox.h"
+#include "event_codec.h"
+#include "wifi_manager.h"
+#include "connectivity.h"
+#include "event_bus.h"
+#include "power_policy.h"
+#include "hall_sensor.h"
+#include "telemetry.h"
+#include "trace.h"
+#include "settings.h"
+#include "rtos_alloc.h"
+#include "esp_pm.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include <stdio.h>
+
+static const char *TAG = "PUBLISHER";
+
+#define PUBLISH_QUEUE_LEN   16   // Transitions buffered between the event bus and the publish task
+#define PUBLISH_WINDOW_MAX  16   // Transitions kept per coalescing window
+
+// Largest per-event encoding of either payload format
+#define EVENT_ENCODED_MAX   (EVENT_TEXT_LINE_MAX > EVENT_BINARY_SIZE ? EVENT_TEXT_LINE_MAX : EVENT_BINARY_SIZE)
+
+static QueueHandle_t publish_queue = NULL;
+RTOS_QUEUE_STORAGE(publish, PUBLISH_QUEUE_LEN, sizeof(bus_event_t));
+RTOS_TASK_STORAGE(publisher, MQTT_TASK_STACK_SIZE);
+static esp_mqtt_client_handle_t mqtt_client = NULL;
+static portMUX_TYPE last_event_lock = portMUX_INITIALIZER_UNLOCKED;
+static door_event_t last_event[HALL_MAX_CHANNELS];  // Most recent transition per channel, for state refreshes
+
+// State topic per Hall channel
+static char state_topics[HALL_MAX_CHANNELS][64];
+static size_t channel_count = 0;
+
+// Event sequence number within this boot, paired with outbox_boot_id()
+static uint32_t next_seq = 0;
+
+// Outbox replay in flight (one batch at a time, acknowledged via MQTT_EVENT_PUBLISHED)
+static int replay_msg_id = -1;
+static uint32_t replay_end_index = 0;
+
+// Light sleep is blocked while QoS 1 publishes wait for their PUBACK
+static esp_pm_lock_handle_t mqtt_pm_lock = NULL;
+static portMUX_TYPE inflight_lock = portMUX_INITIALIZER_UNLOCKED;
+static int inflight_count = 0;
+
+/**
+ * @brief QoS 1 publish that holds the PM lock until MQTT_EVENT_PUBLISHED
+ * @return Message id, or -1 on failure
+ */
+static int publish_tracked(const char *topic, const char *data, int len)
+{
+    int msg_id = esp_mqtt_client_publish(mqtt_client, topic, data, len, 1, 0);
+    if (msg_id >= 0) {
+        telemetry_count(TELEMETRY_PUBLISHED);
+        trace_publish_sent(msg_id);
+    }
+    if (msg_id > 0 && mqtt_pm_lock != NULL) {
+        portENTER_CRITICAL(&inflight_lock);
+        inflight_count++;
+        esp_pm_lock_acquire(mqtt_pm_lock);
+        portEXIT_CRITICAL(&inflight_lock);
+    }
+    return msg_id;
+}
+
+/**
+ * @brief Release the PM lock for acknowledged (or abandoned) publishes
+ */
+static void release_inflight(bool all)
+{
+    if (mqtt_pm_lock == NULL) {
+        return;
+    }
+    
+    portENTER_CRITICAL(&inflight_lock);
+    while (inflight_count > 0) {
+        inflight_count--;
+        esp_pm_lock_release(mqtt_pm_lock);
+        if (!all) {
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&inflight_lock);
+}
+
+static const char *channel_id(uint8_t channel)
+{
+    // Replayed records may predate a change of the channel table
+    const hall_channel_config_t *config = hall_sensor_get_channel(channel);
+    return config ? config->id : "";
+}
+
+/**
+ * @brief Encode events back to back in the events topic format
+ * @return Payload length in bytes
+ */
+static int encode_events(const door_event_t *events, size_t count, char *buf, size_t len)
+{
+    size_t used = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (MQTT_EVENTS_FORMAT == PAYLOAD_FORMAT_BINARY) {
+            used += event_encode_binary(&events[i], (uint8_t *)buf + used, len - used);
+        } else {
+            used += event_format_text(&events[i], channel_id(events[i].channel), buf + used, len - used);
+        }
+    }
+    return (int)used;
+}
+
+static void publish_state(const door_event_t *event)
+{
+    if (MQTT_STATE_FORMAT == PAYLOAD_FORMAT_BINARY) {
+        uint8_t payload[EVENT_BINARY_SIZE];
+        size_t len = event_encode_binary(event, payload, sizeof(payload));
+        publish_tracked(state_topics[event->channel], (const char *)payload, len);
+    } else {
+        publish_tracked(state_topics[event->channel], event_state_text(event->open), 0);
+    }
+    BINLOG(PUBLISHED, BINLOG_STR(event_state_text(event->open)), BINLOG_STR(state_topics[event->channel]),
+           event->seq);
+}
+
+static void event_to_record(const door_event_t *event, outbox_record_t *record)
+{
+    record->seq = event->seq;
+    record->timestamp_ms = (uint32_t)(event->timestamp_us / 1000);
+    record->boot_id = event->boot_id;
+    record->state = (event->open ? OUTBOX_STATE_OPEN : 0) | (event->channel << OUTBOX_STATE_CHANNEL_SHIFT);
+    record->bounce_count = event->bounce_count;
+}
+
+static void record_to_event(const outbox_record_t *record, door_event_t *event)
+{
+    // The outbox keeps millisecond timestamps and no RSSI
+    event->seq = record->seq;
+    event->timestamp_us = (int64_t)record->timestamp_ms * 1000;
+    event->boot_id = record->boot_id;
+    event->open = (record->state & OUTBOX_STATE_OPEN) != 0;
+    event->channel = record->state >> OUTBOX_STATE_CHANNEL_SHIFT;
+    event->bounce_count = record->bounce_count;
+    event->rssi = 0;
+}
+
+/**
+ * @brief Deliver the transitions of one window to the events topic, or store them in the outbox
+ */
+static void record_events(const door_event_t *events, size_t count)
+{
+    if (connectivity_is_online() && outbox_pending() == 0) {
+        if (!MQTT_PACK_EVENTS || count < 2) {
+            return;
+        }
+        
+        // All transitions of a bursty window in one message
+        char payload[PUBLISH_WINDOW_MAX * EVENT_ENCODED_MAX];
+        int len = encode_events(events, count, payload, sizeof(payload));
+        publish_tracked(MQTT_TOPIC_EVENTS, payload, len);
+        return;
+    }
+    
+    // Offline, or older events still being replayed: keep the history in order
+    for (size_t i = 0; i < count; i++) {
+        outbox_record_t record;
+        event_to_record(&events[i], &record);
+        outbox_append(&record);
+    }
+    if (!connectivity_is_online()) {
+        BINLOG(STORED_OFFLINE, count);
+    }
+}
+
+/**
+ * @brief Publish the next batch of outbox records as one message
+ * Records are removed from the outbox only once the broker acknowledged the batch.
+ */
+static void replay_outbox_batch(void)
+{
+    outbox_record_t records[OUTBOX_REPLAY_BATCH];
+    size_t count = outbox_peek(records, OUTBOX_REPLAY_BATCH, &replay_end_index);
+    if (count == 0) {
+        replay_msg_id = -1;
+        return;
+    }
+    
+    // Stay out of max modem sleep until the replay is acknowledged
+    power_policy_notify(POWER_ACTIVITY_MQTT_TX);
+    
+    door_event_t events[OUTBOX_REPLAY_BATCH];
+    for (size_t i = 0; i < count; i++) {
+        record_to_event(&records[i], &events[i]);
+    }
+    
+    char payload[OUTBOX_REPLAY_BATCH * EVENT_ENCODED_MAX];
+    int len = encode_events(events, count, payload, sizeof(payload));
+    
+    replay_msg_id = publish_tracked(MQTT_TOPIC_EVENTS, payload, len);
+    BINLOG(REPLAYING, count, outbox_pending());
+}
+
+static void window_add(door_event_t *window, size_t *count, const hall_event_t *event)
+{
+    door_event_t record = {
+        .seq = next_seq++,
+        .timestamp_us = event->timestamp_us,
+        .channel = event->channel,
+        .boot_id = outbox_boot_id(),
+        .open = event->open,
+        .bounce_count = event->bounce_count,
+        .rssi = wifi_get_rssi(),
+    };
+    portENTER_CRITICAL(&last_event_lock);
+    last_event[event->channel] = record;
+    portEXIT_CRITICAL(&last_event_lock);
+    
+    // Keep the newest transition if the window is full
+    if (*count < PUBLISH_WINDOW_MAX) {
+        window[(*count)++] = record;
+    } else {
+        window[PUBLISH_WINDOW_MAX - 1] = record;
+    }
+}
+
+// ----------------- Publish task -----------------
+static void publisher_task(void *pvParameters)
+{
+    door_event_t window[PUBLISH_WINDOW_MAX];
+    bool published_open[HALL_MAX_CHANNELS];
+    for (size_t ch = 0; ch < HALL_MAX_CHANNELS; ch++) {
+        published_open[ch] = last_event[ch].open;
+    }
+    
+    while (1) {
+        bus_event_t event;
+        xQueueReceive(publish_queue, &event, portMAX_DELAY);
+        
+        // Keep the radio responsive while the event is published
+        power_policy_notify(POWER_ACTIVITY_DOOR);
+        
+        size_t count = 0;
+        uint32_t transitions = 1;
+        window_add(window, &count, &event.door);
+        
+        // The leading transition goes out immediately
+        if (connectivity_is_online()) {
+            publish_state(&window[0]);
+            published_open[event.door.channel] = event.door.open;
+            trace_record(TRACE_DETECT_TO_PUBLISH, esp_timer_get_time() - event.posted_us);
+        }
+        
+        // Merge every further transition inside the window into one trailing publish per channel
+        uint16_t window_ms = settings_get()->coalesce_window_ms;
+        int64_t window_end = esp_timer_get_time() + (int64_t)window_ms * 1000;
+        while (window_ms > 0) {
+            int64_t remaining_us = window_end - esp_timer_get_time();
+            if (remaining_us <= 0 ||
+                xQueueReceive(publish_queue, &event, pdMS_TO_TICKS(remaining_us / 1000) + 1) != pdTRUE) {
+                break;
+            }
+            window_add(window, &count, &event.door);
+            transitions++;
+        }
+        
+        for (size_t ch = 0; ch < channel_count; ch++) {
+            const door_event_t *final = NULL;
+            for (size_t i = 0; i < count; i++) {
+                if (window[i].channel == ch) {
+                    final = &window[i];
+                }
+            }
+            if (final != NULL && connectivity_is_online() && final->open != published_open[ch]) {
+                publish_state(final);
+                published_open[ch] = final->open;
+            }
+        }
+        
+        if (transitions > 1) {
+            BINLOG(COALESCED, transitions);
+        }
+        
+        record_events(window, count);
+    }
+}
+
+esp_err_t publisher_init(void)
+{
+    channel_count = hall_sensor_get_channel_count();
+    for (size_t ch = 0; ch < channel_count; ch++) {
+        const char *id = channel_id(ch);
+        if (id[0] == '\0') {
+            snprintf(state_topics[ch], sizeof(state_topics[ch]), "%s", MQTT_TOPIC_STATE);
+        } else {
+            snprintf(state_topics[ch], sizeof(state_topics[ch]), "%s/%s/state", MQTT_TOPIC_PREFIX, id);
+        }
+        
+        last_event[ch] = (door_event_t){
+            .boot_id = outbox_boot_id(),
+            .channel = ch,
+            .open = true,
+        };
+    }
+    
+    // Not supported without CONFIG_PM_ENABLE; publishes are then simply untracked
+    if (esp_pm_lock_create(ESP_PM_NO_LIGHT_SLEEP, 0, "mqtt_tx", &mqtt_pm_lock) != ESP_OK) {
+        mqtt_pm_lock = NULL;
+    }
+    
+    // MQTT delivery and the offline outbox are one subscriber of the door event bus
+    publish_queue = event_bus_subscribe("publisher", PUBLISH_QUEUE_LEN, RTOS_QUEUE(publish));
+    if (publish_queue == NULL) {
+        ESP_LOGE(TAG, "Failed to subscribe to door events");
+        return ESP_FAIL;
+    }
+    
+    esp_err_t ret = rtos_task_create(publisher_task, "publisher", MQTT_TASK_STACK_SIZE, NULL,
+                                     MQTT_TASK_PRIORITY, RTOS_CORE_NETWORK, RTOS_TASK(publisher), NULL);
+    if (ret != ESP_OK) {
+        // The subscription stays registered; its queue simply fills up and drops
+        ESP_LOGE(TAG, "Failed to create publisher task");
+        return ESP_FAIL;
+    }
+    
+    ESP_LOGI(TAG, "Publisher initialized (coalescing window %ums)", settings_get()->coalesce_window_ms);
+    return ESP_OK;
+}
+
+void publisher_set_client(esp_mqtt_client_handle_t client)
+{
+    mqtt_client = client;
+}
+
+void publisher_on_connected(void)
+{
+    telemetry_count(TELEMETRY_MQTT_CONNECTS);
+    
+    // Refresh the state topics and replay door events stored while offline
+    if (outbox_pending() > 0) {
+        for (size_t ch = 0; ch < channel_count; ch++) {
+            portENTER_CRITICAL(&last_event_lock);
+            door_event_t current = last_event[ch];
+            portEXIT_CRITICAL(&last_event_lock);
+            
+            publish_state(&current);
+        }
+        replay_outbox_batch();
+    }
+}
+
+void publisher_on_disconnected(void)
+{
+    release_inflight(true);
+    trace_publish_abandon_all();
+    
+    // An unacknowledged batch stays in the outbox and is resent on reconnect
+    replay_msg_id = -1;
+}
+
+void publisher_on_published(int msg_id)
+{
+    release_inflight(false);
+    trace_publish_acked(msg_id);
+    
+    if (replay_msg_id >= 0 && msg_id == replay_msg_id) {
+        outbox_consume_until(replay_end_index);
+        replay_outbox_batch();
+    }
+}
+
+esp_err_t publisher_publish(const char *topic, const char *data, int len, bool retain)
+{
+    if (!connectivity_is_online() || mqtt_client == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    
+    int msg_id = esp_mqtt_client_publish(mqtt_client, topic, data, len, 0, retain ? 1 : 0);
+    return msg_id < 0 ? ESP_FAIL : ESP_OK;
+}
@@ -0,0 +1,49 @@
+#ifndef PUBLISHER_H
+#define PUBLISHER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "mqtt_client.h"
+
+/**
+ * @brief Initialize the publish stage, subscribe it to door events and start its task
+ * Requires the outbox and the Hall sensor channels to be initialized.
+ * @return ESP_OK on success, error code on failure
+ */
+esp_err_t publisher_init(void);
+
+/**
+ * @brief Set MQTT client used for publishing
+ * @param client MQTT client handle
+ */
+void publisher_set_client(esp_mqtt_client_handle_t client);
+
+/**
+ * @brief Notify the publish stage that MQTT connected (call when connectivity turns CONN_STATE_ONLINE)
+ * Refreshes the state topic and starts replaying the outbox.
+ */
+void publisher_on_connected(void);
+
+/**
+ * @brief Notify the publish stage that MQTT disconnected (call when connectivity leaves CONN_STATE_ONLINE)
+ */
+void publisher_on_disconnected(void);
+
+/**
+ * @brief Forward MQTT_EVENT_PUBLISHED acknowledgements to the publish stage
+ * @param msg_id Message id of the acknowledged publish
+ */
+void publisher_on_published(int msg_id);
+
+/**
+ * @brief Publish a QoS 0 message outside the door event path (status, diagnostics)
+ * @param topic Topic
+ * @param data Payload
+ * @param len Payload length, 0 for a NUL-terminated string
+ * @param retain Retain flag
+ * @return ESP_OK on success, ESP_ERR_INVALID_STATE if MQTT is not connected
+ */
+esp_err_t publisher_publish(const char *topic, const char *data, int len, bool retain);
+
+#endif // PUBLISHER_H
@@ -0,0 +1,122 @@
+#include "rtos_alloc.h"
+#include "esp_log.h"
+#include <stdbool.h>
+
+static const char *TAG = "RTOS";
+
+typedef struct {
+    TaskHandle_t handle;
+    const char *name;
+    uint32_t stack_size;
+    BaseType_t core_id;
+} tracked_task_t;
+
+static tracked_task_t tasks[RTOS_MAX_TASKS];
+static size_t task_count = 0;
+static portMUX_TYPE tasks_lock = portMUX_INITIALIZER_UNLOCKED;
+
+esp_err_t rtos_task_create(TaskFunction_t task, const char *name, uint32_t stack_size, void *arg,
+                           UBaseType_t priority, BaseType_t core_id, StackType_t *stack,
+                           StaticTask_t *tcb, TaskHandle_t *handle)
+{
+    TaskHandle_t created = NULL;
+    
+    if (RTOS_STATIC_ALLOCATION) {
+        created = xTaskCreateStaticPinnedToCore(task, name, stack_size, arg, priority, stack, tcb, core_id);
+    } else if (xTaskCreatePinnedToCore(task, name, stack_size, arg, priority, &created, core_id) != pdPASS) {
+        created = NULL;
+    }
+    
+    if (created == NULL) {
+        ESP_LOGE(TAG, "Failed to create task %s (%lu byte stack)", name, (unsigned long)stack_size);
+        return ESP_ERR_NO_MEM;
+    }
+    
+    portENTER_CRITICAL(&tasks_lock);
+    if (task_count < RTOS_MAX_TASKS) {
+        tasks[task_count++] = (tracked_task_t){ created, name, stack_size, core_id };
+    }
+    portEXIT_CRITICAL(&tasks_lock);
+    
+    if (handle != NULL) {
+        *handle = created;
+    }
+    return ESP_OK;
+}
+
+void rtos_task_delete(TaskHandle_t handle)
+{
+    portENTER_CRITICAL(&tasks_lock);
+    for (size_t i = 0; i < task_count; i++) {
+        if (tasks[i].handle == handle) {
+            tasks[i] = tasks[--task_count];
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&tasks_lock);
+    
+    vTaskDelete(handle);
+}
+
+QueueHandle_t rtos_queue_create(UBaseType_t length, UBaseType_t item_size,
+                                uint8_t *items, StaticQueue_t *queue)
+{
+    if (RTOS_STATIC_ALLOCATION) {
+        return xQueueCreateStatic(length, item_size, items, queue);
+    }
+    return xQueueCreate(length, item_size);
+}
+
+SemaphoreHandle_t rtos_mutex_create(StaticSemaphore_t *mutex)
+{
+    if (RTOS_STATIC_ALLOCATION) {
+        return xSemaphoreCreateMutexStatic(mutex);
+    }
+    return xSemaphoreCreateMutex();
+}
+
+EventGroupHandle_t rtos_event_group_create(StaticEventGroup_t *group)
+{
+    if (RTOS_STATIC_ALLOCATION) {
+        return xEventGroupCreateStatic(group);
+    }
+    return xEventGroupCreate();
+}
+
+size_t rtos_task_count(void)
+{
+    return task_count;
+}
+
+esp_err_t rtos_task_get_stats(size_t index, rtos_task_stats_t *stats)
+{
+    if (stats == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    portENTER_CRITICAL(&tasks_lock);
+    bool valid = index < task_count;
+    tracked_task_t task = valid ? tasks[index] : (tracked_task_t){0};
+    portEXIT_CRITICAL(&tasks_lock);
+    if (!valid) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    stats->name = task.name;
+    stats->stack_size = task.stack_size;
+    stats->high_water_mark = uxTaskGetStackHighWaterMark(task.handle);
+    stats->core_id = task.core_id;
+    return ESP_OK;
+}
+
+uint32_t rtos_min_stack_headroom(void)
+{
+    uint32_t headroom = UINT32_MAX;
+    rtos_task_stats_t stats;
+    for (size_t i = 0; rtos_task_get_stats(i, &stats) == ESP_OK; i++) {
+        if (stats.high_water_mark < headroom) {
+            headroom = stats.high_water_mark;
+        }
+    }
+    return headroom;
+}
@@ -0,0 +1,121 @@
+#ifndef RTOS_ALLOC_H
+#define RTOS_ALLOC_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "config.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/event_groups.h"
+
+/*
+ * Task, queue, mutex and event group creation that honours RTOS_STATIC_ALLOCATION.
+ * Storage is declared next to its owner with the macros below; it shrinks to one
+ * element when static allocation is off and the heap is used instead.
+ */
+
+#define RTOS_MAX_TASKS  10  // Tasks tracked for stack high-water marks
+
+// Core plan: Hall capture and buzzer timing on one core, WiFi/MQTT work on the other
+#if TASK_CORE_PINNING && portNUM_PROCESSORS > 1
+#define RTOS_CORE_SENSOR    SENSOR_CORE
+#define RTOS_CORE_NETWORK   NETWORK_CORE
+#else
+#define RTOS_CORE_SENSOR    tskNO_AFFINITY
+#define RTOS_CORE_NETWORK   tskNO_AFFINITY
+#endif
+
+// ESP-IDF FreeRTOS sizes stacks in bytes (StackType_t is uint8_t)
+#define RTOS_TASK_STORAGE(name, stack_size) \
+    static StackType_t name##_stack[RTOS_STATIC_ALLOCATION ? (stack_size) : 1]; \
+    static StaticTask_t name##_tcb
+
+#define RTOS_QUEUE_STORAGE(name, length, item_size) \
+    static uint8_t name##_queue_items[RTOS_STATIC_ALLOCATION ? (length) * (item_size) : 1]; \
+    static StaticQueue_t name##_queue_buffer
+
+#define RTOS_MUTEX_STORAGE(name)        static StaticSemaphore_t name##_mutex_buffer
+#define RTOS_EVENT_GROUP_STORAGE(name)  static StaticEventGroup_t name##_group_buffer
+
+// Pass the storage declared with the macros above
+#define RTOS_TASK(name)         name##_stack, &name##_tcb
+#define RTOS_QUEUE(name)        name##_queue_items, &name##_queue_buffer
+#define RTOS_MUTEX(name)        &name##_mutex_buffer
+#define RTOS_EVENT_GROUP(name)  &name##_group_buffer
+
+/**
+ * @brief Stack usage of a task created with rtos_task_create()
+ */
+typedef struct {
+    const char *name;
+    uint32_t stack_size;        // Bytes reserved
+    uint32_t high_water_mark;   // Bytes never used since the task started
+    BaseType_t core_id;         // Pinned core, tskNO_AFFINITY if unpinned
+} rtos_task_stats_t;
+
+/**
+ * @brief Create a task and track its stack usage
+ * @param task Task function
+ * @param name Task name
+ * @param stack_size Stack size in bytes (must match the RTOS_TASK_STORAGE size)
+ * @param arg Task argument
+ * @param priority Priority
+ * @param core_id RTOS_CORE_SENSOR, RTOS_CORE_NETWORK or tskNO_AFFINITY
+ * @param stack Stack storage, used when RTOS_STATIC_ALLOCATION is set
+ * @param tcb Task control block storage, used when RTOS_STATIC_ALLOCATION is set
+ * @param handle Receives the task handle (may be NULL)
+ * @return ESP_OK on success, ESP_ERR_NO_MEM on failure
+ */
+esp_err_t rtos_task_create(TaskFunction_t task, const char *name, uint32_t stack_size, void *arg,
+                           UBaseType_t priority, BaseType_t core_id, StackType_t *stack,
+                           StaticTask_t *tcb, TaskHandle_t *handle);
+
+/**
+ * @brief Stop tracking and delete a task created with rtos_task_create()
+ * @param handle Task handle
+ */
+void rtos_task_delete(TaskHandle_t handle);
+
+/**
+ * @brief Create a queue
+ * @return Queue handle, NULL on failure
+ */
+QueueHandle_t rtos_queue_create(UBaseType_t length, UBaseType_t item_size,
+                                uint8_t *items, StaticQueue_t *queue);
+
+/**
+ * @brief Create a mutex
+ * @return Mutex handle, NULL on failure
+ */
+SemaphoreHandle_t rtos_mutex_create(StaticSemaphore_t *mutex);
+
+/**
+ * @brief Create an event group
+ * @return Event group handle, NULL on failure
+ */
+EventGroupHandle_t rtos_event_group_create(StaticEventGroup_t *group);
+
+/**
+ * @brief Get the number of tracked tasks
+ * @return Task count
+ */
+size_t rtos_task_count(void);
+
+/**
+ * @brief Get the stack usage of a tracked task
+ * @param index Task index, below rtos_task_count()
+ * @param stats Receives the stack usage
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG for an unknown index
+ */
+esp_err_t rtos_task_get_stats(size_t index, rtos_task_stats_t *stats);
+
+/**
+ * @brief Get the smallest stack headroom of all tracked tasks
+ * @return Bytes, UINT32_MAX if no task is tracked
+ */
+uint32_t rtos_min_stack_headroom(void);
+
+#endif // RTOS_ALLOC_H
@@ -0,0 +1,205 @@
+#include "settings.h"
+#include "config.h"
+#include "esp_log.h"
+#include "esp_wifi.h"
+#include "nvs.h"
+#include <stdio.h>
+#include <string.h>
+
+static const char *TAG = "SETTINGS";
+
+#define SETTINGS_NVS_NS     "settings"
+
+/**
+ * @brief Descriptor of one setting: NVS key, field in settings_t and valid range
+ */
+typedef struct {
+    const char *key;            // NVS key (max 15 chars) and name used by SET
+    uint8_t offset;
+    uint8_t size;               // 1, 2 or 4 bytes
+    uint32_t min;
+    uint32_t max;
+    uint32_t default_value;
+} setting_def_t;
+
+#define SETTING(name, field, lo, hi, def) \
+    { name, offsetof(settings_t, field), sizeof(((settings_t *)0)->field), lo, hi, def }
+
+static const setting_def_t setting_defs[] = {
+    SETTING("debounce_ms", debounce_ms,          0, 2000,  0),
+    SETTING("coalesce_ms", coalesce_window_ms,   0, 5000,  MQTT_COALESCE_WINDOW_MS),
+    SETTING("beep_times",  beep_times,           0, 20,    BEEP_DEFAULT_TIMES),
+    SETTING("beep_ms",     beep_duration_ms,     20, 2000, BEEP_DEFAULT_DURATION),
+    SETTING("boost_ms",    boost_hold_ms,        0, 600000, POWER_BOOST_HOLD_MS),
+    SETTING("idle_ps",     idle_ps_mode,         WIFI_PS_NONE, WIFI_PS_MAX_MODEM, POWER_IDLE_PS_MODE),
+    SETTING("boost_ps",    boost_ps_mode,        WIFI_PS_NONE, WIFI_PS_MAX_MODEM, POWER_BOOST_PS_MODE),
+    SETTING("telemetry_s", telemetry_interval_s, 0, 86400, TELEMETRY_INTERVAL_S),
+    SETTING("ajar_s",      ajar_timeout_s,       0, 86400, DOOR_AJAR_TIMEOUT_S),
+};
+
+#define SETTING_COUNT (sizeof(setting_defs) / sizeof(setting_defs[0]))
+
+// Each entry is at most ,"<15-char key>":<10 digits>, plus the braces
+_Static_assert(SETTING_COUNT * (4 + 15 + 10) + 2 < SETTINGS_JSON_MAX, "SETTINGS_JSON_MAX too small for the setting table");
+
+static settings_t settings;
+static nvs_handle_t settings_nvs = 0;
+static void (*change_callback)(void) = NULL;
+
+static void field_store(const setting_def_t *def, uint32_t value)
+{
+    uint8_t *field = (uint8_t *)&settings + def->offset;
+    
+    // Aligned stores of at most 32 bits, so readers never see a torn value
+    switch (def->size) {
+        case 1: *(uint8_t *)field = (uint8_t)value; break;
+        case 2: *(uint16_t *)field = (uint16_t)value; break;
+        default: *(uint32_t *)field = value; break;
+    }
+}
+
+static uint32_t field_load(const setting_def_t *def)
+{
+    const uint8_t *field = (const uint8_t *)&settings + def->offset;
+    
+    switch (def->size) {
+        case 1: return *(const uint8_t *)field;
+        case 2: return *(const uint16_t *)field;
+        default: return *(const uint32_t *)field;
+    }
+}
+
+static const setting_def_t *setting_find(const char *key)
+{
+    for (size_t i = 0; i < SETTING_COUNT; i++) {
+        if (strcmp(setting_defs[i].key, key) == 0) {
+            return &setting_defs[i];
+        }
+    }
+    return NULL;
+}
+
+esp_err_t settings_init(void)
+{
+    for (size_t i = 0; i < SETTING_COUNT; i++) {
+        field_store(&setting_defs[i], setting_defs[i].default_value);
+    }
+    
+    esp_err_t ret = nvs_open(SETTINGS_NVS_NS, NVS_READWRITE, &settings_nvs);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to open settings namespace: %s", esp_err_to_name(ret));
+        settings_nvs = 0;
+        return ret;
+    }
+    
+    // Missing keys keep their default; out-of-range values (older firmware) are ignored
+    size_t overrides = 0;
+    for (size_t i = 0; i < SETTING_COUNT; i++) {
+        const setting_def_t *def = &setting_defs[i];
+        uint32_t value;
+        if (nvs_get_u32(settings_nvs, def->key, &value) != ESP_OK) {
+            continue;
+        }
+        if (value < def->min || value > def->max) {
+            ESP_LOGW(TAG, "Stored %s=%lu out of range, using default", def->key, (unsigned long)value);
+            continue;
+        }
+        field_store(def, value);
+        overrides++;
+    }
+    
+    ESP_LOGI(TAG, "Settings loaded (%u of %u from NVS)", (unsigned)overrides, (unsigned)SETTING_COUNT);
+    return ESP_OK;
+}
+
+const settings_t *settings_get(void)
+{
+    return &settings;
+}
+
+esp_err_t settings_set(const char *key, int32_t value)
+{
+    const setting_def_t *def = setting_find(key);
+    if (def == NULL) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    if (value < 0 || (uint32_t)value < def->min || (uint32_t)value > def->max) {
+        ESP_LOGW(TAG, "%s=%ld out of range [%lu, %lu]", key, (long)value,
+                 (unsigned long)def->min, (unsigned long)def->max);
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (settings_nvs == 0) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    
+    esp_err_t ret = nvs_set_u32(settings_nvs, def->key, (uint32_t)value);
+    if (ret == ESP_OK) {
+        ret = nvs_commit(settings_nvs);
+    }
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to store %s: %s", key, esp_err_to_name(ret));
+        return ret;
+    }
+    
+    field_store(def, (uint32_t)value);
+    ESP_LOGI(TAG, "%s = %ld", key, (long)value);
+    
+    if (change_callback != NULL) {
+        change_callback();
+    }
+    return ESP_OK;
+}
+
+esp_err_t settings_reset(void)
+{
+    if (settings_nvs == 0) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    
+    esp_err_t ret = nvs_erase_all(settings_nvs);
+    if (ret == ESP_OK) {
+        ret = nvs_commit(settings_nvs);
+    }
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to erase settings: %s", esp_err_to_name(ret));
+        return ret;
+    }
+    
+    for (size_t i = 0; i < SETTING_COUNT; i++) {
+        field_store(&setting_defs[i], setting_defs[i].default_value);
+    }
+    ESP_LOGI(TAG, "Settings reset to defaults");
+    
+    if (change_callback != NULL) {
+        change_callback();
+    }
+    return ESP_OK;
+}
+
+size_t settings_format_json(char *buf, size_t len)
+{
+    if (buf == NULL || len == 0) {
+        return 0;
+    }
+    
+    size_t used = 0;
+    for (size_t i = 0; i <= SETTING_COUNT; i++) {
+        int written;
+        if (i < SETTING_COUNT) {
+            written = snprintf(buf + used, len - used, "%s\"%s\":%lu", i ? "," : "{",
+                               setting_defs[i].key, (unsigned long)field_load(&setting_defs[i]));
+        } else {
+            written = snprintf(buf + used, len - used, "}");
+        }
+        if (written < 0 || (size_t)written >= len - used) {
+            return 0;
+        }
+        used += written;
+    }
+    return used;
+}
+
+void settings_set_change_callback(void (*callback)(void))
+{
+    change_callback = callback;
+}
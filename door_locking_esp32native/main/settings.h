@@ -0,0 +1,67 @@
+#ifndef SETTINGS_H
+#define SETTINGS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+#define SETTINGS_JSON_MAX   320 // Buffer size that always fits settings_format_json()
+
+/**
+ * @brief Runtime tunables, loaded from NVS once at startup (defaults from config.h)
+ * Read the fields directly; they are only written by settings_set() and settings_reset().
+ */
+typedef struct {
+    uint16_t debounce_ms;           // Stable window for every Hall channel, 0 = per-channel HALL_CHANNELS value
+    uint16_t coalesce_window_ms;    // MQTT_COALESCE_WINDOW_MS
+    uint16_t beep_times;            // BEEP_DEFAULT_TIMES
+    uint16_t beep_duration_ms;      // BEEP_DEFAULT_DURATION
+    uint32_t boost_hold_ms;         // POWER_BOOST_HOLD_MS
+    uint8_t idle_ps_mode;           // POWER_IDLE_PS_MODE (wifi_ps_type_t)
+    uint8_t boost_ps_mode;          // POWER_BOOST_PS_MODE (wifi_ps_type_t)
+    uint32_t telemetry_interval_s;  // TELEMETRY_INTERVAL_S
+    uint32_t ajar_timeout_s;        // DOOR_AJAR_TIMEOUT_S, 0 = no door-ajar alerts
+} settings_t;
+
+/**
+ * @brief Load settings from NVS, falling back to config.h defaults
+ * NVS must already be initialized.
+ * @return ESP_OK on success, error code on failure (defaults are still loaded)
+ */
+esp_err_t settings_init(void);
+
+/**
+ * @brief Get the live settings
+ * @return Pointer to the settings struct (never NULL)
+ */
+const settings_t *settings_get(void);
+
+/**
+ * @brief Validate, persist and apply one setting
+ * @param key Setting name ("debounce_ms", "coalesce_ms", ...)
+ * @param value New value
+ * @return ESP_OK on success, ESP_ERR_NOT_FOUND for an unknown key, ESP_ERR_INVALID_ARG if out of range
+ */
+esp_err_t settings_set(const char *key, int32_t value);
+
+/**
+ * @brief Restore and persist the config.h defaults
+ * @return ESP_OK on success, error code on failure
+ */
+esp_err_t settings_reset(void);
+
+/**
+ * @brief Format all settings as JSON
+ * @param buf Output buffer
+ * @param len Buffer size, SETTINGS_JSON_MAX always fits
+ * @return Length written, 0 if the buffer is too small
+ */
+size_t settings_format_json(char *buf, size_t len);
+
+/**
+ * @brief Register a function called after settings changed (from the calling task)
+ * @param callback Function to call
+ */
+void settings_set_change_callback(void (*callback)(void));
+
+#endif // SETTINGS_H
@@ -0,0 +1,233 @@
+#include "telemetry.h"
+#include "config.h"
+#include "publisher.h"
+#include "outbox.h"
+#include "command.h"
+#include "wifi_manager.h"
+#include "connectivity.h"
+#include "hall_sensor.h"
+#include "trace.h"
+#include "settings.h"
+#include "rtos_alloc.h"
+#include "esp_log.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+
+static const char *TAG = "TELEMETRY";
+
+/**
+ * @brief Payload fields; every value has a fixed width inside the JSON template
+ */
+typedef enum {
+    FIELD_UPTIME = 0,
+    FIELD_RSSI,
+    FIELD_HEAP,
+    FIELD_HEAP_MIN,
+    FIELD_STATE,
+    FIELD_EVENTS,
+    FIELD_PUBLISHED,
+    FIELD_PENDING,
+    FIELD_DROPPED,
+    FIELD_COMMANDS,
+    FIELD_REJECTED,
+    FIELD_CONNECTS,
+    FIELD_QUEUE_DROPPED,
+    FIELD_MISSED,
+    FIELD_STACK_MIN,
+    FIELD_BOOT,
+    FIELD_COUNT
+} telemetry_field_t;
+
+typedef struct {
+    const char *key;
+    uint8_t width;
+} field_def_t;
+
+static const field_def_t fields[FIELD_COUNT] = {
+    [FIELD_UPTIME]    = { "uptime_s",  10 },
+    [FIELD_RSSI]      = { "rssi",      4 },
+    [FIELD_HEAP]      = { "heap",      7 },
+    [FIELD_HEAP_MIN]  = { "heap_min",  7 },
+    [FIELD_STATE]     = { "open_mask", 3 },
+    [FIELD_EVENTS]    = { "events",    10 },
+    [FIELD_PUBLISHED] = { "published", 10 },
+    [FIELD_PENDING]   = { "outbox",    5 },
+    [FIELD_DROPPED]   = { "dropped",   10 },
+    [FIELD_COMMANDS]  = { "commands",  10 },
+    [FIELD_REJECTED]  = { "rejected",  10 },
+    [FIELD_CONNECTS]  = { "connects",  10 },
+    [FIELD_QUEUE_DROPPED] = { "q_dropped", 10 },
+    [FIELD_MISSED]    = { "missed",    10 },
+    [FIELD_STACK_MIN] = { "stack_min", 5 },
+    [FIELD_BOOT]      = { "boot",      5 },
+};
+
+static atomic_uint counters[TELEMETRY_COUNTER_COUNT];
+static atomic_uint door_state_mask = 0;
+
+// JSON template with space-padded numbers, e.g. {"uptime_s":      1234,"rssi": -61,...}
+static char payload[384];
+static char trace_payload[896];  // Latency histograms, formatted on demand
+_Static_assert(sizeof(trace_payload) >= TRACE_JSON_MAX, "trace payload too small for the worst case");
+static size_t payload_len = 0;
+static uint16_t field_offset[FIELD_COUNT];
+static int64_t field_value[FIELD_COUNT];  // Value currently rendered in the template
+static SemaphoreHandle_t payload_mutex = NULL;
+RTOS_MUTEX_STORAGE(payload);
+static esp_timer_handle_t report_timer = NULL;
+
+/**
+ * @brief Write a right-aligned, space-padded decimal into a fixed-width slot
+ */
+static void render_number(char *slot, uint8_t width, int64_t value)
+{
+    bool negative = value < 0;
+    uint64_t magnitude = negative ? (uint64_t)(-value) : (uint64_t)value;
+    int pos = width - 1;
+    
+    do {
+        slot[pos--] = (char)('0' + magnitude % 10);
+        magnitude /= 10;
+    } while (magnitude > 0 && pos >= 0);
+    
+    if (negative && pos >= 0) {
+        slot[pos--] = '-';
+    }
+    while (pos >= 0) {
+        slot[pos--] = ' ';
+    }
+}
+
+static void update_field(telemetry_field_t field, int64_t value)
+{
+    // Only fields that changed since the last report are rewritten
+    if (field_value[field] != value) {
+        field_value[field] = value;
+        render_number(&payload[field_offset[field]], fields[field].width, value);
+    }
+}
+
+static void report_timer_callback(void *arg)
+{
+    // Publishing may block, so hand the report to the command worker task
+    command_submit("STATUS", 6);
+}
+
+esp_err_t telemetry_init(void)
+{
+    payload_mutex = rtos_mutex_create(RTOS_MUTEX(payload));
+    if (payload_mutex == NULL) {
+        ESP_LOGE(TAG, "Failed to create telemetry mutex");
+        return ESP_FAIL;
+    }
+    
+    // Build the template once; reports only overwrite digits in place
+    size_t len = 0;
+    payload[len++] = '{';
+    for (int i = 0; i < FIELD_COUNT; i++) {
+        int written = snprintf(&payload[len], sizeof(payload) - len, "%s\"%s\":",
+                               i ? "," : "", fields[i].key);
+        len += written;
+        field_offset[i] = (uint16_t)len;
+        field_value[i] = 0;
+        render_number(&payload[len], fields[i].width, 0);
+        len += fields[i].width;
+    }
+    payload[len++] = '}';
+    payload[len] = '\0';
+    payload_len = len;
+    
+    const esp_timer_create_args_t timer_args = {
+        .callback = report_timer_callback,
+        .arg = NULL,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "telemetry",
+    };
+    
+    esp_err_t ret = esp_timer_create(&timer_args, &report_timer);
+    if (ret == ESP_OK) {
+        ret = telemetry_set_interval(settings_get()->telemetry_interval_s);
+    }
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to start telemetry timer: %s", esp_err_to_name(ret));
+        return ret;
+    }
+    
+    ESP_LOGI(TAG, "Telemetry initialized (%u byte payload, every %lus)",
+             (unsigned)payload_len, (unsigned long)settings_get()->telemetry_interval_s);
+    return ESP_OK;
+}
+
+esp_err_t telemetry_set_interval(uint32_t interval_s)
+{
+    if (report_timer == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    
+    // Not running is fine: the timer is stopped for interval 0 or before the first start
+    esp_timer_stop(report_timer);
+    if (interval_s == 0) {
+        return ESP_OK;
+    }
+    return esp_timer_start_periodic(report_timer, (uint64_t)interval_s * 1000000ULL);
+}
+
+void telemetry_count(telemetry_counter_t counter)
+{
+    if (counter < TELEMETRY_COUNTER_COUNT) {
+        atomic_fetch_add_explicit(&counters[counter], 1, memory_order_relaxed);
+    }
+}
+
+void telemetry_set_door_state(uint8_t channel, bool open)
+{
+    if (open) {
+        atomic_fetch_or_explicit(&door_state_mask, 1u << channel, memory_order_relaxed);
+    } else {
+        atomic_fetch_and_explicit(&door_state_mask, ~(1u << channel), memory_order_relaxed);
+    }
+}
+
+esp_err_t telemetry_publish(void)
+{
+    if (payload_mutex == NULL) {
+        return ESP_FAIL;
+    }
+    if (!connectivity_is_online()) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    
+    xSemaphoreTake(payload_mutex, portMAX_DELAY);
+    
+    update_field(FIELD_UPTIME, esp_timer_get_time() / 1000000);
+    update_field(FIELD_RSSI, wifi_get_rssi());
+    update_field(FIELD_HEAP, esp_get_free_heap_size());
+    update_field(FIELD_HEAP_MIN, esp_get_minimum_free_heap_size());
+    update_field(FIELD_STATE, atomic_load_explicit(&door_state_mask, memory_order_relaxed));
+    update_field(FIELD_EVENTS, atomic_load_explicit(&counters[TELEMETRY_DOOR_EVENTS], memory_order_relaxed));
+    update_field(FIELD_PUBLISHED, atomic_load_explicit(&counters[TELEMETRY_PUBLISHED], memory_order_relaxed));
+    update_field(FIELD_PENDING, outbox_pending());
+    update_field(FIELD_DROPPED, outbox_dropped());
+    update_field(FIELD_COMMANDS, atomic_load_explicit(&counters[TELEMETRY_COMMANDS], memory_order_relaxed));
+    update_field(FIELD_REJECTED, atomic_load_explicit(&counters[TELEMETRY_COMMANDS_REJECTED], memory_order_relaxed));
+    update_field(FIELD_CONNECTS, atomic_load_explicit(&counters[TELEMETRY_MQTT_CONNECTS], memory_order_relaxed));
+    update_field(FIELD_QUEUE_DROPPED, trace_get_count(TRACE_QUEUE_DROPPED));
+    update_field(FIELD_MISSED, hall_sensor_get_overflow_count() + trace_get_count(TRACE_ACK_LOST));
+    update_field(FIELD_STACK_MIN, rtos_min_stack_headroom() == UINT32_MAX ? 0 : rtos_min_stack_headroom());
+    update_field(FIELD_BOOT, outbox_boot_id());
+    
+    esp_err_t ret = publisher_publish(MQTT_TOPIC_STATUS, payload, (int)payload_len, true);
+    if (ret == ESP_OK) {
+        // A cut-off document would stay retained; skip it instead
+        size_t len = trace_format_json(trace_payload, sizeof(trace_payload));
+        ret = len > 0 ? publisher_publish(MQTT_TOPIC_TRACE, trace_payload, (int)len, true) : ESP_ERR_INVALID_SIZE;
+    }
+    
+    xSemaphoreGive(payload_mutex);
+    return ret;
+}
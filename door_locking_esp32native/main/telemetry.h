@@ -0,0 +1,53 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+/**
+ * @brief Hot-path counters reported in the status payload
+ */
+typedef enum {
+    TELEMETRY_DOOR_EVENTS = 0,    // Debounced transitions
+    TELEMETRY_PUBLISHED,          // QoS 1 publishes handed to the MQTT client
+    TELEMETRY_COMMANDS,           // Commands executed
+    TELEMETRY_COMMANDS_REJECTED,  // Unknown, malformed or failed commands
+    TELEMETRY_MQTT_CONNECTS,      // Broker (re)connections
+    TELEMETRY_COUNTER_COUNT
+} telemetry_counter_t;
+
+/**
+ * @brief Initialize telemetry: build the payload template and start the periodic report
+ * @return ESP_OK on success, error code on failure
+ */
+esp_err_t telemetry_init(void);
+
+/**
+ * @brief Change the period of the status report
+ * @param interval_s Seconds between reports, 0 = only on STATUS
+ * @return ESP_OK on success, error code on failure
+ */
+esp_err_t telemetry_set_interval(uint32_t interval_s);
+
+/**
+ * @brief Increment a counter (lock-free, safe from any task)
+ * @param counter Counter to increment
+ */
+void telemetry_count(telemetry_counter_t counter);
+
+/**
+ * @brief Record the debounced state of a Hall channel
+ * @param channel Channel index
+ * @param open true if open
+ */
+void telemetry_set_door_state(uint8_t channel, bool open);
+
+/**
+ * @brief Refresh changed fields of the status payload and publish it and the latency histograms (retained)
+ * Must not be called from the MQTT event task or an esp_timer callback.
+ * @return ESP_OK on success, ESP_ERR_INVALID_STATE if MQTT is not connected
+ */
+esp_err_t telemetry_publish(void);
+
+#endif // TELEMETRY_H
@@ -0,0 +1,208 @@
+#include "trace.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+
+#define TRACE_INFLIGHT_SLOTS    8   // Unacknowledged QoS 1 publishes tracked for TRACE_PUBLISH_TO_ACK
+
+typedef struct {
+    int msg_id;                 // 0 = free slot
+    int64_t sent_us;
+} inflight_slot_t;
+
+static const char *const stage_names[TRACE_STAGE_COUNT] = {
+    [TRACE_EDGE_TO_DETECT]    = "edge_detect",
+    [TRACE_DETECT_TO_PUBLISH] = "detect_publish",
+    [TRACE_PUBLISH_TO_ACK]    = "publish_ack",
+};
+
+// Histograms are updated from hall_task, the publisher task and the MQTT task
+static portMUX_TYPE trace_lock = portMUX_INITIALIZER_UNLOCKED;
+static trace_histogram_t histograms[TRACE_STAGE_COUNT];
+static inflight_slot_t inflight[TRACE_INFLIGHT_SLOTS];
+static atomic_uint counters[TRACE_COUNTER_COUNT];
+
+static unsigned int bucket_index(uint32_t elapsed_us)
+{
+    uint32_t scaled = elapsed_us / TRACE_BUCKET_BASE_US;
+    if (scaled == 0) {
+        return 0;
+    }
+    
+    unsigned int index = 32 - __builtin_clz(scaled);
+    return index < TRACE_BUCKET_COUNT ? index : TRACE_BUCKET_COUNT - 1;
+}
+
+void trace_record(trace_stage_t stage, int64_t elapsed_us)
+{
+    if (stage >= TRACE_STAGE_COUNT || elapsed_us < 0) {
+        return;
+    }
+    
+    uint32_t us = elapsed_us > UINT32_MAX ? UINT32_MAX : (uint32_t)elapsed_us;
+    unsigned int index = bucket_index(us);
+    
+    portENTER_CRITICAL(&trace_lock);
+    trace_histogram_t *histogram = &histograms[stage];
+    histogram->buckets[index]++;
+    histogram->count++;
+    histogram->sum_us += us;
+    if (us > histogram->max_us) {
+        histogram->max_us = us;
+    }
+    portEXIT_CRITICAL(&trace_lock);
+}
+
+void trace_count(trace_counter_t counter)
+{
+    if (counter < TRACE_COUNTER_COUNT) {
+        atomic_fetch_add_explicit(&counters[counter], 1, memory_order_relaxed);
+    }
+}
+
+void trace_publish_sent(int msg_id)
+{
+    if (msg_id <= 0) {
+        return;
+    }
+    
+    int64_t now = esp_timer_get_time();
+    bool evicted = false;
+    
+    portENTER_CRITICAL(&trace_lock);
+    // Free slot, otherwise the oldest publish is given up
+    size_t victim = 0;
+    for (size_t i = 0; i < TRACE_INFLIGHT_SLOTS; i++) {
+        if (inflight[i].msg_id == 0) {
+            victim = i;
+            break;
+        }
+        if (inflight[i].sent_us < inflight[victim].sent_us) {
+            victim = i;
+        }
+    }
+    evicted = inflight[victim].msg_id != 0;
+    inflight[victim].msg_id = msg_id;
+    inflight[victim].sent_us = now;
+    portEXIT_CRITICAL(&trace_lock);
+    
+    if (evicted) {
+        trace_count(TRACE_ACK_LOST);
+    }
+}
+
+void trace_publish_acked(int msg_id)
+{
+    if (msg_id <= 0) {
+        return;
+    }
+    
+    int64_t sent_us = -1;
+    
+    portENTER_CRITICAL(&trace_lock);
+    for (size_t i = 0; i < TRACE_INFLIGHT_SLOTS; i++) {
+        if (inflight[i].msg_id == msg_id) {
+            sent_us = inflight[i].sent_us;
+            inflight[i].msg_id = 0;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&trace_lock);
+    
+    if (sent_us >= 0) {
+        trace_record(TRACE_PUBLISH_TO_ACK, esp_timer_get_time() - sent_us);
+    }
+}
+
+void trace_publish_abandon_all(void)
+{
+    uint32_t lost = 0;
+    
+    portENTER_CRITICAL(&trace_lock);
+    for (size_t i = 0; i < TRACE_INFLIGHT_SLOTS; i++) {
+        if (inflight[i].msg_id != 0) {
+            inflight[i].msg_id = 0;
+            lost++;
+        }
+    }
+    portEXIT_CRITICAL(&trace_lock);
+    
+    atomic_fetch_add_explicit(&counters[TRACE_ACK_LOST], lost, memory_order_relaxed);
+}
+
+esp_err_t trace_get_histogram(trace_stage_t stage, trace_histogram_t *histogram)
+{
+    if (stage >= TRACE_STAGE_COUNT || histogram == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    portENTER_CRITICAL(&trace_lock);
+    *histogram = histograms[stage];
+    portEXIT_CRITICAL(&trace_lock);
+    return ESP_OK;
+}
+
+uint32_t trace_get_count(trace_counter_t counter)
+{
+    if (counter >= TRACE_COUNTER_COUNT) {
+        return 0;
+    }
+    return atomic_load_explicit(&counters[counter], memory_order_relaxed);
+}
+
+const char *trace_stage_name(trace_stage_t stage)
+{
+    return stage < TRACE_STAGE_COUNT ? stage_names[stage] : "?";
+}
+
+size_t trace_format_json(char *buf, size_t len)
+{
+    size_t used = 0;
+    
+#define TRACE_APPEND(...) do { \
+        int written = snprintf(buf + used, len - used, __VA_ARGS__); \
+        if (written < 0 || (size_t)written >= len - used) { \
+            return 0; \
+        } \
+        used += written; \
+    } while (0)
+    
+    if (buf == NULL || len == 0) {
+        return 0;
+    }
+    
+    TRACE_APPEND("{\"bucket_base_us\":%d", TRACE_BUCKET_BASE_US);
+    for (int stage = 0; stage < TRACE_STAGE_COUNT; stage++) {
+        trace_histogram_t histogram;
+        trace_get_histogram(stage, &histogram);
+        
+        TRACE_APPEND(",\"%s\":{\"n\":%lu,\"avg_us\":%lu,\"max_us\":%lu,\"buckets\":[",
+                     stage_names[stage], (unsigned long)histogram.count,
+                     (unsigned long)(histogram.count ? histogram.sum_us / histogram.count : 0),
+                     (unsigned long)histogram.max_us);
+        for (int i = 0; i < TRACE_BUCKET_COUNT; i++) {
+            TRACE_APPEND("%s%lu", i ? "," : "", (unsigned long)histogram.buckets[i]);
+        }
+        TRACE_APPEND("]}");
+    }
+    TRACE_APPEND(",\"queue_dropped\":%lu,\"ack_lost\":%lu}",
+                 (unsigned long)trace_get_count(TRACE_QUEUE_DROPPED),
+                 (unsigned long)trace_get_count(TRACE_ACK_LOST));
+    
+#undef TRACE_APPEND
+    
+    return used;
+}
+
+void trace_reset(void)
+{
+    portENTER_CRITICAL(&trace_lock);
+    memset(histograms, 0, sizeof(histograms));
+    portEXIT_CRITICAL(&trace_lock);
+    
+    for (int i = 0; i < TRACE_COUNTER_COUNT; i++) {
+        atomic_store_explicit(&counters[i], 0, memory_order_relaxed);
+    }
+}
@@ -0,0 +1,113 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+#define TRACE_BUCKET_COUNT      16  // Bucket 0: < 128us, bucket i: [64us << i, 128us << i), last: overflow
+#define TRACE_BUCKET_BASE_US    128
+
+/**
+ * @brief Latency stages along the door event path
+ */
+typedef enum {
+    TRACE_EDGE_TO_DETECT = 0,   // First ISR edge -> debounced event in hall_task
+    TRACE_DETECT_TO_PUBLISH,    // hall_task -> esp_mqtt_client_publish() of the leading state
+    TRACE_PUBLISH_TO_ACK,       // esp_mqtt_client_publish() -> MQTT_EVENT_PUBLISHED
+    TRACE_STAGE_COUNT
+} trace_stage_t;
+
+/**
+ * @brief Events lost along the door event path
+ */
+typedef enum {
+    TRACE_QUEUE_DROPPED = 0,    // Transitions dropped because the publish queue was full
+    TRACE_ACK_LOST,             // QoS 1 publishes abandoned on disconnect or evicted from the ack table
+    TRACE_COUNTER_COUNT
+} trace_counter_t;
+
+#define TRACE_STAGE_NAME_MAX    14  // Longest stage name ("detect_publish")
+
+// Longest trace_format_json() output including the NUL: every number at 10 digits
+#define TRACE_JSON_MAX  (sizeof("{\"bucket_base_us\":") + 10 + \
+                         TRACE_STAGE_COUNT * (sizeof(",\"\":{\"n\":,\"avg_us\":,\"max_us\":,\"buckets\":[]}") - 1 + \
+                                              TRACE_STAGE_NAME_MAX + 3 * 10 + TRACE_BUCKET_COUNT * 11) + \
+                         sizeof(",\"queue_dropped\":,\"ack_lost\":}") - 1 + 2 * 10)
+
+/**
+ * @brief Snapshot of one latency histogram
+ */
+typedef struct {
+    uint32_t buckets[TRACE_BUCKET_COUNT];
+    uint32_t count;
+    uint32_t max_us;
+    uint64_t sum_us;
+} trace_histogram_t;
+
+/**
+ * @brief Record one latency sample
+ * @param stage Stage the sample belongs to
+ * @param elapsed_us Duration in microseconds (negative samples are ignored)
+ */
+void trace_record(trace_stage_t stage, int64_t elapsed_us);
+
+/**
+ * @brief Increment a loss counter
+ * @param counter Counter to increment
+ */
+void trace_count(trace_counter_t counter);
+
+/**
+ * @brief Remember the send time of a QoS 1 publish for TRACE_PUBLISH_TO_ACK
+ * @param msg_id Message id returned by esp_mqtt_client_publish()
+ */
+void trace_publish_sent(int msg_id);
+
+/**
+ * @brief Record TRACE_PUBLISH_TO_ACK for an acknowledged publish
+ * @param msg_id Message id from MQTT_EVENT_PUBLISHED
+ */
+void trace_publish_acked(int msg_id);
+
+/**
+ * @brief Forget all unacknowledged publishes (counted as TRACE_ACK_LOST)
+ */
+void trace_publish_abandon_all(void);
+
+/**
+ * @brief Copy a histogram
+ * @param stage Stage to read
+ * @param histogram Receives the snapshot
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG for an unknown stage
+ */
+esp_err_t trace_get_histogram(trace_stage_t stage, trace_histogram_t *histogram);
+
+/**
+ * @brief Get a loss counter
+ * @param counter Counter to read
+ * @return Counter value since boot or the last reset
+ */
+uint32_t trace_get_count(trace_counter_t counter);
+
+/**
+ * @brief Get the short name of a stage ("edge_detect", ...)
+ * @param stage Stage
+ * @return Name, or "?" for an unknown stage
+ */
+const char *trace_stage_name(trace_stage_t stage);
+
+/**
+ * @brief Format all histograms and counters as JSON
+ * @param buf Output buffer
+ * @param len Buffer size, TRACE_JSON_MAX always fits
+ * @return Length written, 0 if the buffer is too small
+ */
+size_t trace_format_json(char *buf, size_t len);
+
+/**
+ * @brief Clear all histograms and counters
+ */
+void trace_reset(void);
+
+#endif // TRACE_H
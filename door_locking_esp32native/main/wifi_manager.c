@@ -1,12 +1,18 @@
 #include "wifi_manager.h"
 #include "config.h"
+#include "binlog.h"
 #include "esp_log.h"
 #include "esp_wifi.h"
 #include "esp_netif.h"
 #include "esp_event.h"
+#include "esp_timer.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/event_groups.h"
-#include "driver/gpio.h"
+#include "nvs.h"
+#include "esp_attr.h"
+#include "rtos_alloc.h"
+#include "connectivity.h"
+#include <string.h>
 
 static const char *TAG = "WIFI_MANAGER";
 
@@ -16,77 +22,315 @@ static EventGroupHandle_t s_wifi_event_group;
 #define WIFI_FAIL_BIT      BIT1
 
 static esp_netif_t *s_netif = NULL;
-static TaskHandle_t s_reconnect_task_handle = NULL;
+RTOS_EVENT_GROUP_STORAGE(s_wifi_event);
 
-#define MONITOR_CHECK_INTERVAL 60000   // Monitor checks every 60 seconds as fallback
+// Fast-connect cache: AP and IP lease of the last successful association
+#define FAST_CACHE_MAGIC     0x46434331  // "FCC1"
+#define FAST_CACHE_NVS_NS    "wifi_fast"
+#define FAST_CACHE_NVS_KEY   "cache"
+
+typedef struct {
+    uint32_t magic;
+    uint8_t bssid[6];
+    uint8_t channel;
+    uint8_t static_ip_uses;    // Connects that reused the cached lease since the last DHCP
+    esp_netif_ip_info_t ip_info;
+    uint32_t dns;
+} wifi_fast_cache_t;
+
+// RTC copy survives deep sleep, NVS copy survives power loss
+static RTC_DATA_ATTR wifi_fast_cache_t s_rtc_cache;
+static wifi_fast_cache_t s_pending_cache;   // Filled in on association, committed on IP
+static bool s_fast_connect_active = false;  // Current attempt uses the cached AP
+static bool s_static_ip_active = false;     // Current attempt uses the cached IP lease
+static bool s_bssid_pinned = false;         // STA config is locked to the cached BSSID and channel
+static bool s_dhcp_stopped = false;         // DHCP client stopped for the cached lease, restarted before the next association
+static bool s_lease_from_cache = false;     // Current connection runs on the cached lease, not on one from DHCP
+static bool s_lease_confirmed = false;      // MQTT was reached on the cached lease
+static volatile bool s_lease_rejected = false;  // MQTT deadline missed; set by the lease timer, handled on disconnect
+
+// MQTT deadline after a cached-lease connect, then the delayed DHCP renewal
+static esp_timer_handle_t s_lease_timer = NULL;
+
+static void (*s_connected_callback)(void) = NULL;
+
+static bool fast_cache_valid(const wifi_fast_cache_t *cache)
+{
+    return cache->magic == FAST_CACHE_MAGIC && cache->channel != 0;
+}
 
 /**
- * @brief Background task to monitor WiFi and auto-reconnect
- * This serves as a fallback mechanism - the event handler does the primary reconnection
+ * @brief Load the fast-connect cache, preferring RTC memory over NVS
  */
-static void wifi_monitor_task(void *pvParameters)
+static void fast_cache_load(void)
 {
-    ESP_LOGI(TAG, "WiFi monitor task started (60s interval for fallback)");
+    if (fast_cache_valid(&s_rtc_cache)) {
+        return;
+    }
     
-    while (1) {
-        // Check every 60 seconds as a fallback (event handler does fast reconnect)
-        vTaskDelay(pdMS_TO_TICKS(MONITOR_CHECK_INTERVAL));
-        
-        if (!wifi_is_connected()) {
-            ESP_LOGW(TAG, "Monitor: WiFi still disconnected after 60s, forcing reconnect...");
-            esp_wifi_connect();
-        }
+    nvs_handle_t nvs;
+    if (nvs_open(FAST_CACHE_NVS_NS, NVS_READONLY, &nvs) != ESP_OK) {
+        return;
+    }
+    
+    size_t len = sizeof(s_rtc_cache);
+    if (nvs_get_blob(nvs, FAST_CACHE_NVS_KEY, &s_rtc_cache, &len) != ESP_OK || len != sizeof(s_rtc_cache)) {
+        memset(&s_rtc_cache, 0, sizeof(s_rtc_cache));
+    }
+    nvs_close(nvs);
+}
+
+/**
+ * @brief Store the fast-connect cache in RTC memory, and in NVS only if the AP or lease changed
+ */
+static void fast_cache_store(const wifi_fast_cache_t *cache)
+{
+    bool changed = memcmp(s_rtc_cache.bssid, cache->bssid, sizeof(cache->bssid)) != 0 ||
+                   s_rtc_cache.channel != cache->channel ||
+                   memcmp(&s_rtc_cache.ip_info, &cache->ip_info, sizeof(cache->ip_info)) != 0 ||
+                   s_rtc_cache.dns != cache->dns;
+    
+    s_rtc_cache = *cache;
+    s_rtc_cache.magic = FAST_CACHE_MAGIC;
+    
+    if (!changed) {
+        return;
+    }
+    
+    nvs_handle_t nvs;
+    if (nvs_open(FAST_CACHE_NVS_NS, NVS_READWRITE, &nvs) == ESP_OK) {
+        nvs_set_blob(nvs, FAST_CACHE_NVS_KEY, &s_rtc_cache, sizeof(s_rtc_cache));
+        nvs_commit(nvs);
+        nvs_close(nvs);
+        BINLOG(WIFI_CACHE_UPDATED, s_rtc_cache.channel);
+    }
+}
+
+static void fast_cache_invalidate(void)
+{
+    memset(&s_rtc_cache, 0, sizeof(s_rtc_cache));
+    
+    nvs_handle_t nvs;
+    if (nvs_open(FAST_CACHE_NVS_NS, NVS_READWRITE, &nvs) == ESP_OK) {
+        nvs_erase_key(nvs, FAST_CACHE_NVS_KEY);
+        nvs_commit(nvs);
+        nvs_close(nvs);
     }
 }
 
 /**
- * @brief WiFi event handler with auto-reconnect
+ * @brief Build the STA config, pinning BSSID and channel when a valid cache exists
+ */
+static void wifi_build_config(wifi_config_t *wifi_config, bool use_cache)
+{
+    memset(wifi_config, 0, sizeof(*wifi_config));
+    strncpy((char *)wifi_config->sta.ssid, WIFI_SSID, sizeof(wifi_config->sta.ssid));
+    strncpy((char *)wifi_config->sta.password, WIFI_PASSWORD, sizeof(wifi_config->sta.password));
+    wifi_config->sta.threshold.authmode = WIFI_AUTH_WPA2_PSK;
+    wifi_config->sta.pmf_cfg.capable = true;
+    wifi_config->sta.pmf_cfg.required = false;
+    
+    // Beacon intervals between wakeups in WIFI_PS_MAX_MODEM; sent to the AP at association
+    wifi_config->sta.listen_interval = WIFI_LISTEN_INTERVAL;
+    
+    if (use_cache) {
+        // Single-channel scan for a known BSSID instead of a full scan
+        wifi_config->sta.scan_method = WIFI_FAST_SCAN;
+        wifi_config->sta.bssid_set = true;
+        memcpy(wifi_config->sta.bssid, s_rtc_cache.bssid, sizeof(wifi_config->sta.bssid));
+        wifi_config->sta.channel = s_rtc_cache.channel;
+    }
+}
+
+/**
+ * @brief Apply the cached IP lease instead of running DHCP
+ */
+static void wifi_apply_static_ip(void)
+{
+    esp_err_t ret = esp_netif_dhcpc_stop(s_netif);
+    if (ret != ESP_OK && ret != ESP_ERR_ESP_NETIF_DHCP_ALREADY_STOPPED) {
+        ESP_LOGW(TAG, "Failed to stop DHCP client: %s", esp_err_to_name(ret));
+        s_static_ip_active = false;
+        return;
+    }
+    
+    if (esp_netif_set_ip_info(s_netif, &s_rtc_cache.ip_info) != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to apply cached IP, falling back to DHCP");
+        esp_netif_dhcpc_start(s_netif);
+        s_static_ip_active = false;
+        return;
+    }
+    s_dhcp_stopped = true;
+    
+    if (s_rtc_cache.dns != 0) {
+        esp_netif_dns_info_t dns = {0};
+        dns.ip.u_addr.ip4.addr = s_rtc_cache.dns;
+        dns.ip.type = ESP_IPADDR_TYPE_V4;
+        esp_netif_set_dns_info(s_netif, ESP_NETIF_DNS_MAIN, &dns);
+    }
+}
+
+/**
+ * @brief Hand the interface back to the DHCP client after a cached-lease session
+ */
+static void wifi_restart_dhcp(void)
+{
+    if (!s_dhcp_stopped) {
+        return;
+    }
+    
+    esp_err_t ret = esp_netif_dhcpc_start(s_netif);
+    if (ret != ESP_OK && ret != ESP_ERR_ESP_NETIF_DHCP_ALREADY_STARTED) {
+        ESP_LOGW(TAG, "Failed to restart DHCP client: %s", esp_err_to_name(ret));
+        return;
+    }
+    s_dhcp_stopped = false;
+}
+
+/**
+ * @brief MQTT deadline or lease renewal after a cached-lease connect (esp_timer task)
+ */
+static void lease_timer_callback(void *arg)
+{
+    if (!s_lease_confirmed) {
+        // The lease may belong to another host by now; the disconnect handler drops the cache
+        ESP_LOGW(TAG, "MQTT not reached within %ums on the cached lease", (unsigned)WIFI_FAST_CONNECT_MQTT_TIMEOUT_MS);
+        s_lease_rejected = true;
+        esp_wifi_disconnect();
+        return;
+    }
+    
+    // Renewal: MQTT reconnects once on the lease DHCP hands out, which resets the reuse counter
+    ESP_LOGI(TAG, "Renewing the cached IP lease through DHCP");
+    esp_netif_dhcpc_start(s_netif);
+}
+
+/**
+ * @brief Unpin the cached BSSID so the next attempt scans every channel
+ * The cache itself is kept: a rebooted AP usually returns with the same BSSID.
+ */
+static void wifi_unpin_bssid(void)
+{
+    wifi_config_t wifi_config;
+    wifi_build_config(&wifi_config, false);
+    esp_wifi_set_config(ESP_IF_WIFI_STA, &wifi_config);
+    s_bssid_pinned = false;
+}
+
+/**
+ * @brief Drop the cached AP/lease and reconnect with a full scan and DHCP
+ */
+static void wifi_fallback_full_connect(void)
+{
+    ESP_LOGW(TAG, "Fast connect failed, falling back to full scan and DHCP");
+    
+    s_fast_connect_active = false;
+    s_static_ip_active = false;
+    s_lease_from_cache = false;
+    wifi_restart_dhcp();
+    fast_cache_invalidate();
+    wifi_unpin_bssid();
+}
+
+/**
+ * @brief WiFi event handler; reconnect timing is left to the connectivity controller
  */
 static void wifi_event_handler(void* arg, esp_event_base_t event_base,
                               int32_t event_id, void* event_data)
 {
     if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_START) {
-        esp_wifi_connect();
+        connectivity_on_wifi_started();
+    } else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_CONNECTED) {
+        wifi_event_sta_connected_t* event = (wifi_event_sta_connected_t*) event_data;
+        
+        // Remember the AP for the next fast connect
+        memcpy(s_pending_cache.bssid, event->bssid, sizeof(s_pending_cache.bssid));
+        s_pending_cache.channel = event->channel;
+        
+        if (s_static_ip_active) {
+            wifi_apply_static_ip();
+        }
     } else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_DISCONNECTED) {
-        // Turn off LED when WiFi disconnects
-        gpio_set_level(LED_PIN, 0);
+        wifi_event_sta_disconnected_t* event = (wifi_event_sta_disconnected_t*) event_data;
         
         // Clear connected bit
         xEventGroupClearBits(s_wifi_event_group, WIFI_CONNECTED_BIT);
+        if (s_lease_timer != NULL) {
+            esp_timer_stop(s_lease_timer);
+        }
         
-        ESP_LOGW(TAG, "Disconnected from AP, attempting immediate reconnect...");
+        // A cached AP that cannot be joined, or a cached lease that does not reach MQTT, is stale
+        if (s_fast_connect_active || s_lease_rejected) {
+            s_lease_rejected = false;
+            wifi_fallback_full_connect();
+        } else if (s_bssid_pinned && (event->reason == WIFI_REASON_BEACON_TIMEOUT ||
+                                      event->reason == WIFI_REASON_NO_AP_FOUND)) {
+            // The AP may come back on another channel after a reboot
+            wifi_unpin_bssid();
+        }
+        
+        // The cached lease is used for one association only; the next one runs DHCP
+        s_lease_from_cache = false;
+        wifi_restart_dhcp();
         
-        // Immediate reconnect attempt (ESP-IDF will handle retry logic)
-        esp_wifi_connect();
+        BINLOG(WIFI_DISCONNECTED, event->reason);
+        connectivity_on_wifi_disconnected(event->reason);
         
     } else if (event_base == IP_EVENT && event_id == IP_EVENT_STA_GOT_IP) {
         ip_event_got_ip_t* event = (ip_event_got_ip_t*) event_data;
-        ESP_LOGI(TAG, "Got IP:" IPSTR, IP2STR(&event->ip_info.ip));
+        if (s_static_ip_active) {
+            BINLOG(WIFI_GOT_IP_CACHED, IP2STR(&event->ip_info.ip));
+        } else {
+            BINLOG(WIFI_GOT_IP, IP2STR(&event->ip_info.ip));
+        }
         
-        // Turn on LED when connected
-        gpio_set_level(LED_PIN, 1);
+        // Cache AP and lease; leases obtained from DHCP reset the reuse counter
+        s_pending_cache.ip_info = event->ip_info;
+        s_lease_from_cache = s_static_ip_active;
+        s_lease_confirmed = false;
+        if (s_lease_from_cache) {
+            s_pending_cache.dns = s_rtc_cache.dns;
+            s_pending_cache.static_ip_uses = s_rtc_cache.static_ip_uses + 1;
+            
+            // Confirmed by wifi_on_mqtt_connected(), otherwise the cache is dropped
+            if (s_lease_timer != NULL) {
+                esp_timer_stop(s_lease_timer);
+                esp_timer_start_once(s_lease_timer, (uint64_t)WIFI_FAST_CONNECT_MQTT_TIMEOUT_MS * 1000);
+            }
+        } else {
+            esp_netif_dns_info_t dns;
+            s_pending_cache.dns = (esp_netif_get_dns_info(s_netif, ESP_NETIF_DNS_MAIN, &dns) == ESP_OK) ?
+                                  dns.ip.u_addr.ip4.addr : 0;
+            s_pending_cache.static_ip_uses = 0;
+        }
+        if (WIFI_FAST_CONNECT_ENABLE) {
+            fast_cache_store(&s_pending_cache);
+        }
+        // Later reconnects in this session go through the normal path
+        s_fast_connect_active = false;
+        s_static_ip_active = false;
         
         xEventGroupSetBits(s_wifi_event_group, WIFI_CONNECTED_BIT);
         xEventGroupClearBits(s_wifi_event_group, WIFI_FAIL_BIT);
+        connectivity_on_wifi_got_ip();
+        
+        if (s_connected_callback) {
+            s_connected_callback();
+        }
     }
 }
 
 esp_err_t wifi_init(void)
 {
-    // Configure LED pin using new GPIO driver
-    gpio_config_t led_conf = {
-        .intr_type = GPIO_INTR_DISABLE,
-        .mode = GPIO_MODE_OUTPUT,
-        .pin_bit_mask = (1ULL << LED_PIN),
-        .pull_down_en = GPIO_PULLDOWN_DISABLE,
-        .pull_up_en = GPIO_PULLUP_DISABLE,
-    };
-    gpio_config(&led_conf);
-    gpio_set_level(LED_PIN, 0);  // Start with LED off
-    
     // Initialize TCP/IP adapter
     ESP_ERROR_CHECK(esp_netif_init());
-    ESP_ERROR_CHECK(esp_event_loop_create_default());
+    
+    // The deep-sleep build may have created it for an ESP-NOW attempt
+    esp_err_t ret = esp_event_loop_create_default();
+    if (ret != ESP_OK && ret != ESP_ERR_INVALID_STATE) {
+        ESP_LOGE(TAG, "Failed to create event loop: %s", esp_err_to_name(ret));
+        return ret;
+    }
     
     s_netif = esp_netif_create_default_wifi_sta();
     
@@ -94,25 +338,47 @@ esp_err_t wifi_init(void)
     wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
     ESP_ERROR_CHECK(esp_wifi_init(&cfg));
     
+    // Retry scheduling for both Wi-Fi and MQTT
+    ret = connectivity_init();
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    
     // Create event group
-    s_wifi_event_group = xEventGroupCreate();
+    s_wifi_event_group = rtos_event_group_create(RTOS_EVENT_GROUP(s_wifi_event));
+    if (s_wifi_event_group == NULL) {
+        ESP_LOGE(TAG, "Failed to create WiFi event group");
+        return ESP_FAIL;
+    }
+    
+    const esp_timer_create_args_t timer_args = {
+        .callback = lease_timer_callback,
+        .arg = NULL,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "wifi_lease",
+    };
+    if (esp_timer_create(&timer_args, &s_lease_timer) != ESP_OK) {
+        // Without the deadline and renewal, the cached lease is never trusted
+        ESP_LOGW(TAG, "Failed to create lease timer, not reusing cached IP leases");
+        s_lease_timer = NULL;
+    }
     
     // Register event handlers
     ESP_ERROR_CHECK(esp_event_handler_register(WIFI_EVENT, ESP_EVENT_ANY_ID, &wifi_event_handler, NULL));
     ESP_ERROR_CHECK(esp_event_handler_register(IP_EVENT, IP_EVENT_STA_GOT_IP, &wifi_event_handler, NULL));
     
-    // Configure WiFi
-    wifi_config_t wifi_config = {
-        .sta = {
-            .ssid = WIFI_SSID,
-            .password = WIFI_PASSWORD,
-            .threshold.authmode = WIFI_AUTH_WPA2_PSK,
-            .pmf_cfg = {
-                .capable = true,
-                .required = false
-            },
-        },
-    };
+    // Configure WiFi, reusing the last AP when a fast-connect cache exists
+    if (WIFI_FAST_CONNECT_ENABLE) {
+        fast_cache_load();
+        s_fast_connect_active = fast_cache_valid(&s_rtc_cache);
+        s_static_ip_active = WIFI_FAST_CONNECT_STATIC_IP && s_fast_connect_active && s_lease_timer != NULL &&
+                             s_rtc_cache.ip_info.ip.addr != 0 &&
+                             s_rtc_cache.static_ip_uses < WIFI_FAST_CONNECT_IP_REUSE_LIMIT;
+    }
+    
+    wifi_config_t wifi_config;
+    wifi_build_config(&wifi_config, s_fast_connect_active);
+    s_bssid_pinned = s_fast_connect_active;
     
     ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
     ESP_ERROR_CHECK(esp_wifi_set_config(ESP_IF_WIFI_STA, &wifi_config));
@@ -125,38 +391,28 @@ esp_err_t wifi_init(void)
     ESP_ERROR_CHECK(esp_wifi_set_max_tx_power(44)); // 11 dBm = 44 * 0.25 dBm (low power mode)
     
     ESP_LOGI(TAG, "WiFi initialization finished");
-    ESP_LOGI(TAG, "Connecting to %s...", WIFI_SSID);
+    ESP_LOGI(TAG, "Connecting to %s%s...", WIFI_SSID, s_fast_connect_active ? " (fast connect)" : "");
+    return ESP_OK;
+}
+
+esp_err_t wifi_set_connected_callback(void (*callback)(void))
+{
+    s_connected_callback = callback;
+    return ESP_OK;
+}
+
+bool wifi_wait_connected(TickType_t timeout)
+{
+    if (s_wifi_event_group == NULL) {
+        return false;
+    }
     
-    // Wait for initial connection (with timeout)
     EventBits_t bits = xEventGroupWaitBits(s_wifi_event_group,
                                           WIFI_CONNECTED_BIT,
                                           pdFALSE,
                                           pdFALSE,
-                                          pdMS_TO_TICKS(10000)); // 10 second timeout
-    
-    if (bits & WIFI_CONNECTED_BIT) {
-        ESP_LOGI(TAG, "Connected to WiFi SSID:%s", WIFI_SSID);
-        // Turn on LED to indicate WiFi connection
-        gpio_set_level(LED_PIN, 1);
-    } else {
-        ESP_LOGW(TAG, "Initial connection failed, will retry in background");
-    }
-    
-    // Start background monitoring task (will keep retrying forever)
-    BaseType_t ret = xTaskCreate(wifi_monitor_task, 
-                                 "wifi_monitor", 
-                                 3072,  // Stack size
-                                 NULL, 
-                                 3,     // Priority
-                                 &s_reconnect_task_handle);
-    
-    if (ret != pdPASS) {
-        ESP_LOGE(TAG, "Failed to create WiFi monitor task");
-        return ESP_FAIL;
-    }
-    
-    ESP_LOGI(TAG, "WiFi monitor task created - will auto-reconnect indefinitely");
-    return ESP_OK;
+                                          timeout);
+    return (bits & WIFI_CONNECTED_BIT) != 0;
 }
 
 bool wifi_is_connected(void)
@@ -185,42 +441,48 @@ const char* wifi_get_ip_address(void)
     return NULL;
 }
 
-// esp_err_t wifi_reconnect(void)
-// {
-//     if (wifi_is_connected()) {
-//         return ESP_OK;
-//     }
-    
-//     ESP_LOGI(TAG, "Reconnecting to WiFi...");
-//     s_retry_num = 0;
-//     esp_wifi_connect();
-    
-//     // Wait for connection
-//     EventBits_t bits = xEventGroupWaitBits(s_wifi_event_group,
-//                                           WIFI_CONNECTED_BIT | WIFI_FAIL_BIT,
-//                                           pdFALSE,
-//                                           pdFALSE,
-//                                           pdMS_TO_TICKS(10000)); // 10 second timeout
-    
-//     if (bits & WIFI_CONNECTED_BIT) {
-//         ESP_LOGI(TAG, "Reconnected to WiFi");
-//         // Turn on LED to indicate WiFi reconnection
-//         gpio_set_level(LED_PIN, 1);
-//         return ESP_OK;
-//     } else {
-//         ESP_LOGW(TAG, "Failed to reconnect to WiFi");
-//         return ESP_FAIL;
-//     }
-// }
+int8_t wifi_get_rssi(void)
+{
+    if (!wifi_is_connected()) {
+        return 0;
+    }
+    
+    wifi_ap_record_t ap_info;
+    if (esp_wifi_sta_get_ap_info(&ap_info) != ESP_OK) {
+        return 0;
+    }
+    
+    return ap_info.rssi;
+}
 
-esp_err_t wifi_manager_deinit(void)
+void wifi_on_mqtt_connected(void)
+{
+    if (!s_lease_from_cache || s_lease_confirmed || s_lease_timer == NULL) {
+        return;
+    }
+    
+    s_lease_confirmed = true;
+    esp_timer_stop(s_lease_timer);
+    if (WIFI_FAST_CONNECT_DHCP_RENEW_S > 0) {
+        esp_timer_start_once(s_lease_timer, (uint64_t)WIFI_FAST_CONNECT_DHCP_RENEW_S * 1000000ULL);
+    }
+}
+
+uint8_t wifi_get_cached_channel(void)
 {
-    // Stop monitor task
-    if (s_reconnect_task_handle) {
-        vTaskDelete(s_reconnect_task_handle);
-        s_reconnect_task_handle = NULL;
+    if (!WIFI_FAST_CONNECT_ENABLE) {
+        return 0;
     }
     
+    fast_cache_load();
+    return fast_cache_valid(&s_rtc_cache) ? s_rtc_cache.channel : 0;
+}
+
+esp_err_t wifi_manager_deinit(void)
+{
+    // Stop pending reconnects
+    connectivity_deinit();
+    
     if (s_wifi_event_group) {
         vEventGroupDelete(s_wifi_event_group);
         s_wifi_event_group = NULL;
@@ -3,13 +3,29 @@
 
 #include "esp_err.h"
 #include "esp_wifi.h"
+#include "freertos/FreeRTOS.h"
 
 /**
- * @brief Initialize WiFi connection
+ * @brief Initialize WiFi and start connecting in the background
+ * Does not wait for the connection; use wifi_wait_connected() or the connected callback
  * @return ESP_OK on success, error code on failure
  */
 esp_err_t wifi_init(void);
 
+/**
+ * @brief Set callback invoked from the event loop every time an IP is obtained
+ * @param callback Function to call on connection (NULL to clear)
+ * @return ESP_OK on success, error code on failure
+ */
+esp_err_t wifi_set_connected_callback(void (*callback)(void));
+
+/**
+ * @brief Wait until WiFi is connected and has an IP address
+ * @param timeout Maximum time to wait in ticks
+ * @return true if connected, false on timeout
+ */
+bool wifi_wait_connected(TickType_t timeout);
+
 /**
  * @brief Check if WiFi is connected
  * @return true if connected, false otherwise
@@ -23,10 +39,24 @@ bool wifi_is_connected(void);
 const char* wifi_get_ip_address(void);
 
 /**
- * @brief Reconnect to WiFi if disconnected
- * @return ESP_OK on success, error code on failure
+ * @brief Get signal strength of the current AP
+ * @return RSSI in dBm, 0 if not connected
+ */
+int8_t wifi_get_rssi(void);
+
+/**
+ * @brief Report that the MQTT broker was reached
+ * Confirms a connection made on the cached IP lease. Without it the cache is dropped
+ * WIFI_FAST_CONNECT_MQTT_TIMEOUT_MS after the connect and WiFi reconnects with a full scan and DHCP.
+ */
+void wifi_on_mqtt_connected(void);
+
+/**
+ * @brief Get the channel of the last AP joined, from the fast-connect cache
+ * Works before wifi_init() (needs NVS), so a deep-sleep node can reach an ESP-NOW gateway without associating.
+ * @return Channel, 0 if no successful connection is cached or WIFI_FAST_CONNECT_ENABLE is off
  */
-esp_err_t wifi_reconnect(void);
+uint8_t wifi_get_cached_channel(void);
 
 /**
  * @brief Deinitialize WiFi
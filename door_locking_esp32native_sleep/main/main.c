@@ -0,0 +1,401 @@
+/*
+ * ESP32-S3 Door Lock Monitoring System - Deep-sleep build
+ * Based on A3144 Hall Sensor
+ *
+ * Battery-optimized variant of door_locking_esp32native:
+ * - Deep sleep between door events
+ * - EXT0/EXT1 wakeup on Hall sensor level change
+ * - Last state and sequence number kept in RTC memory
+ * - One MQTT publish per wakeup, then back to sleep
+ * - Optional ESP-NOW delivery through an always-on gateway, without joining the AP
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/event_groups.h"
+#include "esp_system.h"
+#include "esp_log.h"
+#include "esp_sleep.h"
+#include "esp_event.h"
+#include "esp_now.h"
+#include "esp_random.h"
+#include "nvs_flash.h"
+#include "driver/gpio.h"
+#include "driver/rtc_io.h"
+
+// ESP-IDF MQTT header
+#include "mqtt_client.h"
+
+#include "config.h"
+#include "sleep_config.h"
+#include "wifi_manager.h"
+#include "mqtt_config.h"
+#include "boot_profile.h"
+#include "event_codec.h"
+
+static const char *TAG = "DOOR_LOCK_SLEEP";
+
+// State preserved across deep sleep
+static RTC_DATA_ATTR int rtc_last_level = -1;       // -1 = unknown (cold boot)
+static RTC_DATA_ATTR uint32_t rtc_sequence = 0;     // Incremented for every published change
+static RTC_DATA_ATTR uint32_t rtc_wake_count = 0;
+static RTC_DATA_ATTR uint16_t rtc_boot_id = 0;      // Random per power-on; (boot_id, seq) identifies an event
+
+// MQTT cycle state
+static EventGroupHandle_t s_mqtt_event_group;
+#define MQTT_CONNECTED_BIT BIT0
+#define MQTT_PUBLISHED_BIT BIT1
+#define MQTT_ERROR_BIT     BIT2
+
+static esp_mqtt_client_handle_t mqtt_client = NULL;
+static int publish_msg_id = -1;
+
+// ESP-NOW cycle state
+static EventGroupHandle_t s_espnow_event_group;
+#define ESPNOW_ACKED_BIT   BIT0
+#define ESPNOW_FAILED_BIT  BIT1
+
+_Static_assert(sizeof(ESPNOW_PMK) - 1 == ESP_NOW_KEY_LEN, "ESPNOW_PMK must be 16 characters");
+_Static_assert(sizeof(ESPNOW_LMK) - 1 == 0 || sizeof(ESPNOW_LMK) - 1 == ESP_NOW_KEY_LEN,
+               "ESPNOW_LMK must be 16 characters, or \"\" for unencrypted frames");
+
+// ----------------- MQTT callback -----------------
+static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_t event_id, void *event_data)
+{
+    esp_mqtt_event_handle_t event = event_data;
+    
+    switch ((esp_mqtt_event_id_t)event_id) {
+        case MQTT_EVENT_CONNECTED:
+            ESP_LOGI(TAG, "Connected to MQTT broker");
+            wifi_on_mqtt_connected();
+            xEventGroupSetBits(s_mqtt_event_group, MQTT_CONNECTED_BIT);
+            break;
+            
+        case MQTT_EVENT_PUBLISHED:
+            if (event->msg_id == publish_msg_id) {
+                xEventGroupSetBits(s_mqtt_event_group, MQTT_PUBLISHED_BIT);
+            }
+            break;
+            
+        case MQTT_EVENT_DISCONNECTED:
+        case MQTT_EVENT_ERROR:
+            ESP_LOGW(TAG, "MQTT error or disconnect (event %d)", (int)event_id);
+            xEventGroupSetBits(s_mqtt_event_group, MQTT_ERROR_BIT);
+            break;
+            
+        default:
+            break;
+    }
+}
+
+/**
+ * @brief Publish the cycle timings of the profiling build on the open connection
+ * QoS 0 is written to the socket before esp_mqtt_client_publish() returns, so it needs no extra wait.
+ */
+static void mqtt_publish_profile(void)
+{
+    static char payload[1536];
+    size_t len = boot_profile_format_json(payload, sizeof(payload));
+    if (len == 0) {
+        return;
+    }
+    
+    if (esp_mqtt_client_publish(mqtt_client, MQTT_TOPIC_PROFILE, payload, (int)len, 0, 1) >= 0) {
+        boot_profile_mark_published();
+    }
+}
+
+/**
+ * @brief Connect to the broker, publish one state message and wait for its PUBACK
+ * @return ESP_OK once the broker acknowledged the message
+ */
+static esp_err_t mqtt_publish_state(bool door_open)
+{
+    // Same broker, TLS and session settings as the always-on build
+    esp_mqtt_client_config_t mqtt_cfg = {0};
+    esp_err_t ret = mqtt_config_build(&mqtt_cfg);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    
+    s_mqtt_event_group = xEventGroupCreate();
+    mqtt_client = esp_mqtt_client_init(&mqtt_cfg);
+    if (s_mqtt_event_group == NULL || mqtt_client == NULL) {
+        ESP_LOGE(TAG, "Failed to initialize MQTT client");
+        return ESP_FAIL;
+    }
+    
+    esp_mqtt_client_register_event(mqtt_client, ESP_EVENT_ANY_ID, mqtt_event_handler, NULL);
+    
+    ret = esp_mqtt_client_start(mqtt_client);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to start MQTT client: %s", esp_err_to_name(ret));
+        return ret;
+    }
+    
+    EventBits_t bits = xEventGroupWaitBits(s_mqtt_event_group,
+                                          MQTT_CONNECTED_BIT | MQTT_ERROR_BIT,
+                                          pdFALSE,
+                                          pdFALSE,
+                                          pdMS_TO_TICKS(SLEEP_MQTT_TIMEOUT_MS));
+    if (!(bits & MQTT_CONNECTED_BIT)) {
+        ESP_LOGW(TAG, "MQTT connection failed");
+        return ESP_ERR_TIMEOUT;
+    }
+    boot_profile_mark(BOOT_PHASE_MQTT_CONNECTED);
+    
+    // Retained, so subscribers see the current state while the device sleeps
+    const char *payload = door_open ? "OPEN" : "CLOSED";
+    publish_msg_id = esp_mqtt_client_publish(mqtt_client, MQTT_TOPIC_STATE, payload, 0, 1, 1);
+    if (publish_msg_id < 0) {
+        ESP_LOGE(TAG, "Failed to publish state");
+        return ESP_FAIL;
+    }
+    
+    bits = xEventGroupWaitBits(s_mqtt_event_group,
+                               MQTT_PUBLISHED_BIT,
+                               pdFALSE,
+                               pdFALSE,
+                               pdMS_TO_TICKS(SLEEP_MQTT_TIMEOUT_MS));
+    if (!(bits & MQTT_PUBLISHED_BIT)) {
+        ESP_LOGW(TAG, "No PUBACK for seq %lu", (unsigned long)rtc_sequence + 1);
+        return ESP_ERR_TIMEOUT;
+    }
+    
+    boot_profile_mark(BOOT_PHASE_PUBLISHED);
+    ESP_LOGI(TAG, "Published: %s (seq %lu)", payload, (unsigned long)rtc_sequence + 1);
+    
+    // After the state, so profiling never delays the event itself
+    if (BOOT_PROFILE_ENABLE) {
+        mqtt_publish_profile();
+    }
+    return ESP_OK;
+}
+
+// ----------------- ESP-NOW delivery -----------------
+static void espnow_send_callback(const esp_now_send_info_t *tx_info, esp_now_send_status_t status)
+{
+    xEventGroupSetBits(s_espnow_event_group, status == ESP_NOW_SEND_SUCCESS ? ESPNOW_ACKED_BIT : ESPNOW_FAILED_BIT);
+}
+
+/**
+ * @brief Start the radio on the gateway's channel without associating, and register the gateway
+ */
+static esp_err_t espnow_start(uint8_t channel)
+{
+    // The WiFi driver posts its events here; wifi_init() reuses the loop on fallback
+    esp_err_t ret = esp_event_loop_create_default();
+    if (ret != ESP_OK && ret != ESP_ERR_INVALID_STATE) {
+        return ret;
+    }
+    
+    wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
+    ret = esp_wifi_init(&cfg);
+    if (ret == ESP_OK) {
+        ret = esp_wifi_set_mode(WIFI_MODE_STA);
+    }
+    if (ret == ESP_OK) {
+        ret = esp_wifi_start();
+    }
+    if (ret == ESP_OK) {
+        ret = esp_wifi_set_channel(channel, WIFI_SECOND_CHAN_NONE);
+    }
+    if (ret == ESP_OK) {
+        ret = esp_now_init();
+    }
+    if (ret == ESP_OK) {
+        ret = esp_now_register_send_cb(espnow_send_callback);
+    }
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    
+    esp_now_peer_info_t peer = {
+        .peer_addr = ESPNOW_GATEWAY_MAC,
+        .channel = channel,
+        .ifidx = WIFI_IF_STA,
+        .encrypt = sizeof(ESPNOW_LMK) - 1 != 0,
+    };
+    if (peer.encrypt) {
+        esp_now_set_pmk((const uint8_t *)ESPNOW_PMK);
+        memcpy(peer.lmk, ESPNOW_LMK, ESP_NOW_KEY_LEN);
+    } else {
+        ESP_LOGW(TAG, "ESPNOW_LMK is empty, the door state is sent unencrypted");
+    }
+    return esp_now_add_peer(&peer);
+}
+
+/**
+ * @brief Send the state to the ESP-NOW gateway and wait for its link-layer ACK
+ * Leaves the radio off on failure, so WiFi can be initialized for the MQTT fallback.
+ * @return ESP_OK once the gateway received the frame
+ */
+static esp_err_t espnow_publish_state(bool door_open)
+{
+    // The gateway listens on its AP's channel
+    uint8_t channel = ESPNOW_CHANNEL != 0 ? ESPNOW_CHANNEL : wifi_get_cached_channel();
+    if (channel == 0) {
+        ESP_LOGI(TAG, "Gateway channel unknown until the first WiFi connection");
+        return ESP_ERR_NOT_FOUND;
+    }
+    
+    s_espnow_event_group = xEventGroupCreate();
+    if (s_espnow_event_group == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    
+    esp_err_t ret = espnow_start(channel);
+    boot_profile_mark(BOOT_PHASE_WIFI_START);
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "ESP-NOW start failed: %s", esp_err_to_name(ret));
+    }
+    
+    door_event_t event = {
+        .seq = rtc_sequence + 1,
+        .boot_id = rtc_boot_id,
+        .channel = 0,
+        .open = door_open,
+    };
+    uint8_t frame[EVENT_COMPACT_SIZE];
+    size_t len = event_encode_compact(&event, frame, sizeof(frame));
+    const uint8_t gateway[ESP_NOW_ETH_ALEN] = ESPNOW_GATEWAY_MAC;
+    
+    // Resent with the same seq; the gateway drops copies whose ACK got lost
+    for (int attempt = 0; ret == ESP_OK && attempt < SLEEP_ESPNOW_ATTEMPTS; attempt++) {
+        xEventGroupClearBits(s_espnow_event_group, ESPNOW_ACKED_BIT | ESPNOW_FAILED_BIT);
+        if (esp_now_send(gateway, frame, len) != ESP_OK) {
+            continue;
+        }
+        
+        EventBits_t bits = xEventGroupWaitBits(s_espnow_event_group,
+                                              ESPNOW_ACKED_BIT | ESPNOW_FAILED_BIT,
+                                              pdFALSE,
+                                              pdFALSE,
+                                              pdMS_TO_TICKS(SLEEP_ESPNOW_ACK_TIMEOUT_MS));
+        if (bits & ESPNOW_ACKED_BIT) {
+            boot_profile_mark(BOOT_PHASE_PUBLISHED);
+            ESP_LOGI(TAG, "Sent to gateway: %s (seq %lu, attempt %d)", event_state_text(door_open),
+                     (unsigned long)event.seq, attempt + 1);
+            esp_now_deinit();
+            return ESP_OK;
+        }
+    }
+    
+    ESP_LOGW(TAG, "Gateway not reached on channel %u, falling back to WiFi", channel);
+    esp_now_deinit();
+    esp_wifi_stop();
+    esp_wifi_deinit();
+    return ESP_ERR_TIMEOUT;
+}
+
+// ----------------- Hall sensor sampling -----------------
+static int hall_sample_level(void)
+{
+    // Hand the pin back from the RTC domain to the digital GPIO matrix
+    rtc_gpio_deinit(HALL_PIN);
+    
+    gpio_config_t io_conf = {
+        .intr_type = GPIO_INTR_DISABLE,
+        .mode = GPIO_MODE_INPUT,
+        .pin_bit_mask = (1ULL << HALL_PIN),
+        .pull_down_en = GPIO_PULLDOWN_DISABLE,
+        .pull_up_en = GPIO_PULLUP_ENABLE,
+    };
+    gpio_config(&io_conf);
+    
+    // Wait for the Hall output to settle, then require two matching samples
+    int level;
+    do {
+        level = gpio_get_level(HALL_PIN);
+        vTaskDelay(pdMS_TO_TICKS(SLEEP_SETTLE_MS));
+    } while (gpio_get_level(HALL_PIN) != level);
+    
+    return level;
+}
+
+// ----------------- Deep sleep -----------------
+static void enter_deep_sleep(int level, bool retry)
+{
+    // Keep the pull-up active in the RTC domain while sleeping
+    rtc_gpio_init(HALL_PIN);
+    rtc_gpio_pullup_en(HALL_PIN);
+    rtc_gpio_pulldown_dis(HALL_PIN);
+    
+    // Wake up as soon as the pin leaves the level we just reported
+#if SLEEP_WAKEUP_USE_EXT1
+    esp_sleep_pd_config(ESP_PD_DOMAIN_RTC_PERIPH, ESP_PD_OPTION_ON);
+    ESP_ERROR_CHECK(esp_sleep_enable_ext1_wakeup(1ULL << HALL_PIN,
+                                                 level ? ESP_EXT1_WAKEUP_ANY_LOW : ESP_EXT1_WAKEUP_ANY_HIGH));
+#else
+    ESP_ERROR_CHECK(esp_sleep_enable_ext0_wakeup(HALL_PIN, !level));
+#endif
+    
+    if (retry) {
+        esp_sleep_enable_timer_wakeup((uint64_t)SLEEP_RETRY_INTERVAL_S * 1000000ULL);
+    } else if (SLEEP_HEARTBEAT_INTERVAL_S > 0) {
+        esp_sleep_enable_timer_wakeup((uint64_t)SLEEP_HEARTBEAT_INTERVAL_S * 1000000ULL);
+    }
+    
+    ESP_LOGI(TAG, "Entering deep sleep (door %s, wake #%lu)", level ? "OPEN" : "CLOSED", (unsigned long)rtc_wake_count);
+    boot_profile_mark(BOOT_PHASE_SLEEP);
+    esp_deep_sleep_start();
+}
+
+void app_main(void)
+{
+    boot_profile_begin();
+    esp_sleep_wakeup_cause_t cause = esp_sleep_get_wakeup_cause();
+    if (rtc_wake_count++ == 0) {
+        rtc_boot_id = (uint16_t)esp_random();
+    }
+    
+    int level = hall_sample_level();
+    boot_profile_mark(BOOT_PHASE_SENSOR);
+    bool changed = (level != rtc_last_level);
+    bool heartbeat = (cause == ESP_SLEEP_WAKEUP_TIMER);
+    
+    ESP_LOGI(TAG, "Wakeup cause %d, Hall level %d (last %d)", (int)cause, level, rtc_last_level);
+    
+    if (!changed && !heartbeat) {
+        // Spurious wakeup or bounce that settled back - nothing to report
+        enter_deep_sleep(level, false);
+    }
+    
+    // Initialize NVS (required by the WiFi driver)
+    esp_err_t ret = nvs_flash_init();
+    if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND) {
+        ESP_ERROR_CHECK(nvs_flash_erase());
+        ret = nvs_flash_init();
+    }
+    ESP_ERROR_CHECK(ret);
+    boot_profile_mark(BOOT_PHASE_NVS);
+    
+    // One frame without association when a gateway is in range
+    bool published = SLEEP_ESPNOW_ENABLE && espnow_publish_state(level != 0) == ESP_OK;
+    
+    if (!published) {
+        bool wifi_started = wifi_init() == ESP_OK;
+        boot_profile_mark(BOOT_PHASE_WIFI_START);
+        if (wifi_started && wifi_wait_connected(pdMS_TO_TICKS(SLEEP_WIFI_TIMEOUT_MS))) {
+            boot_profile_mark(BOOT_PHASE_WIFI_CONNECTED);
+            published = (mqtt_publish_state(level != 0) == ESP_OK);
+        } else {
+            ESP_LOGW(TAG, "WiFi not connected, skipping publish");
+        }
+    }
+    
+    if (published) {
+        rtc_last_level = level;
+        rtc_sequence++;
+    }
+    
+    // Tear down the radio cleanly before sleeping
+    if (mqtt_client) {
+        esp_mqtt_client_stop(mqtt_client);
+    }
+    esp_wifi_stop();
+    
+    enter_deep_sleep(level, !published);
+}
@@ -0,0 +1,22 @@
+#ifndef SLEEP_CONFIG_H
+#define SLEEP_CONFIG_H
+
+// Deep-sleep build settings.
+// Pins, WiFi and MQTT settings come from door_locking_esp32native/main/config.h
+
+// Wakeup source: 0 = EXT0 (single RTC GPIO level), 1 = EXT1 (RTC GPIO mask)
+#define SLEEP_WAKEUP_USE_EXT1       0
+
+// Timing configuration
+#define SLEEP_SETTLE_MS             50      // Let the Hall output settle after wakeup before sampling
+#define SLEEP_WIFI_TIMEOUT_MS       10000   // Budget for WiFi association + IP
+#define SLEEP_MQTT_TIMEOUT_MS       5000    // Budget for MQTT connect + PUBACK (keep above WIFI_FAST_CONNECT_MQTT_TIMEOUT_MS)
+#define SLEEP_RETRY_INTERVAL_S      300     // Timer wakeup to retry a failed publish
+#define SLEEP_HEARTBEAT_INTERVAL_S  0       // Periodic wakeup to republish state (0 = disabled)
+
+// ESP-NOW delivery to the gateway (ESPNOW_* in config.h), WiFi and MQTT only as the fallback
+#define SLEEP_ESPNOW_ENABLE         0
+#define SLEEP_ESPNOW_ACK_TIMEOUT_MS 20      // Wait for the link-layer ACK of one frame
+#define SLEEP_ESPNOW_ATTEMPTS       3       // Frames sent before falling back to WiFi
+
+#endif // SLEEP_CONFIG_H